@@ -8,7 +8,7 @@ import argparse
 import os.path
 import sys
 import zlib
-import numpy
+import concurrent.futures
 
 
 
@@ -35,6 +35,8 @@ class TROM:
         self.srom = bytes()
         self.vrom = bytes()
         self.bram = bytes()
+        self.key = ""       # content key, see GameKey
+        self.hash = {}      # type_x -> SHA1 of the data
 
 
 crom_max = 0x80000000  # 2048 Mb
@@ -57,6 +59,22 @@ type_srom = 4
 type_mrom = 5
 type_bram = 6
 
+# china pinout C/P adapters, file -> chip, as in the programmer firmware
+# (Dumpers/Firmware/src/User/Src/scramble.c and CV.c): the bit each data bit
+# of the low / high byte of a 16 bit word goes to, and the order of the
+# 32 bit C words within each group of 16 (address lines A0-A3 reversed)
+cv_scr_bits = ([5, 8, 3, 11, 7, 9, 13, 12], [2, 1, 15, 14, 0, 10, 4, 6])
+p_scr_bits = ([15, 7, 14, 6, 13, 5, 12, 4], [0, 8, 1, 9, 2, 10, 3, 11])
+c_addr_scr = [0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf]
+
+# manifest header flags
+man_flag_scrambled = 0x1
+
+# S/M-ROM flash sector, for the delta lists (there is no manifest)
+sm_sector = 0x20000
+# builds of an image kept in the cache, each is a base of its delta list
+dlt_bases = 4
+
 BIT0 = 0x0001
 BIT1 = 0x0002
 BIT2 = 0x0004
@@ -79,6 +97,7 @@ fn = ""
 _sys = 'mvs'
 i = 0
 crom_extend = 0
+prescramble = False
 crom_pos = 0
 prom_pos = 0
 mrom_pos = 0
@@ -163,21 +182,21 @@ def GetBramSize (bram: bytes) -> int:
 
 def PSwap (rom: bytes) -> bytes:
     l = len (rom)
-    tmp = bytearray([0xFF for x in range(l)])
-    for i in range (l // 2):
-        tmp [i * 2 + 0] = rom [i * 2 + 1]
-        tmp [i * 2 + 1] = rom [i * 2 + 0]
+    n = l // 2 * 2
+    tmp = bytearray(b'\xff' * l)
+    tmp [0:n:2] = rom [1:n:2]
+    tmp [1:n:2] = rom [0:n:2]
     return bytes(tmp)
 
 
 def CSwap (rom: bytes) -> bytes:
     l = len (rom)
-    tmp = bytearray([0xFF for x in range(l)])
-    for i in range (l // 4):
-        tmp [i * 4 + 0] = rom [i * 4 + 0]
-        tmp [i * 4 + 1] = rom [i * 4 + 2]
-        tmp [i * 4 + 2] = rom [i * 4 + 1]
-        tmp [i * 4 + 3] = rom [i * 4 + 3]
+    n = l // 4 * 4
+    tmp = bytearray(b'\xff' * l)
+    tmp [0:n:4] = rom [0:n:4]
+    tmp [1:n:4] = rom [2:n:4]
+    tmp [2:n:4] = rom [1:n:4]
+    tmp [3:n:4] = rom [3:n:4]
     return bytes(tmp)
 
 
@@ -185,10 +204,133 @@ def VSplit (rom: bytes):
     roma = rom[0:min(0x200000, len(rom))]
     romb = rom[0x200000:len(rom)]
     if len(romb) < 0x200000:
-        romb = romb + bytes([0 for x in range(0x200000 - len(romb))])
+        romb = romb + bytes(0x200000 - len(romb))
     return (bytes(roma), bytes(romb))
 
 
+# Puts image data into chip bus order, so the programmer can write it as it
+# is. Works on whole sectors: bytes.translate maps all low / high bytes at
+# once, and the two halves of each output byte are merged by OR-ing the
+# translated strings as big integers, so no Python code runs per word.
+class TScramble:
+
+    def __init__ (self, bits, addr: bool):
+        lo = [self.Permute (v, bits [0]) for v in range (256)]
+        hi = [self.Permute (v, bits [1]) for v in range (256)]
+        self.lo_lo = bytes (x & 0xFF for x in lo)
+        self.lo_hi = bytes (x >> 8 for x in lo)
+        self.hi_lo = bytes (x & 0xFF for x in hi)
+        self.hi_hi = bytes (x >> 8 for x in hi)
+        self.addr = addr
+
+    @staticmethod
+    def Permute (v: int, bits) -> int:
+        r = 0
+        for i in range (8):
+            r = r | (((v >> i) & 1) << bits [i])
+        return r
+
+    # buf: bytearray of 16 bit little endian words, a multiple of 64 bytes
+    def Apply (self, buf: bytearray):
+        if self.addr:
+            src = memoryview (bytes (buf)).cast ('I')
+            dst = memoryview (buf).cast ('I')
+            for d in range (16):
+                dst [d::16] = src [c_addr_scr [d]::16]
+        b0 = bytes (buf [0::2])
+        b1 = bytes (buf [1::2])
+        n = len (b0)
+        lo = int.from_bytes (b0.translate (self.lo_lo), 'little') | int.from_bytes (b1.translate (self.hi_lo), 'little')
+        hi = int.from_bytes (b0.translate (self.lo_hi), 'little') | int.from_bytes (b1.translate (self.hi_hi), 'little')
+        buf [0::2] = lo.to_bytes (n, 'little')
+        buf [1::2] = hi.to_bytes (n, 'little')
+
+
+# Incremental builds. Everything is kept as text files in Cache/:
+#
+#   games.txt        <stat hash> <key> <SHA1 of p, c, v, s, m, bram> <name>
+#   mame/<name>.xml  key of the game in MAME/roms/<name>, then its entry
+#   rom/<part>.rcp   VTXRCP 2 <chunk> <part bytes> <flags> <file size>
+#                    <file mtime_ns>, then per chunk
+#                    <recipe> <crc32> <blank> <SHA1 of the chunk>
+#   rom/<part>.bld   VTXBLD 1 <sector> <part bytes>, then the sector CRC32s
+#                    of the last dlt_bases builds, one line each, newest first
+#
+# A game's key is a SHA1 over its settings and data. It is only computed
+# again when the size or modification time of a file in its folder changed.
+# The recipe of an output chunk is a SHA1 over what went into it (SHA1 of
+# the game's data, offset, length, or 0xFF fill), so GenROM can leave a chunk
+# of an existing file alone when its recipe is the same as in the last run.
+# Other chunks are built and hashed, and only written if that hash changed
+# (e.g. the sectors of a game's C-ROM that were not touched). An entry is
+# removed before the output it describes is changed and written afterwards,
+# so an interrupted run does not leave a stale one. An output part is only
+# trusted if its size and modification time are the ones recorded after the
+# last run, so a file that was written by something else is built again.
+cache_dir = 'Cache'
+cache_files = ['prom', 'prom1', 'crom0', 'vroma0', 'srom', 'm1rom', 'bram', 'fpga', 'menu', 'vblank']
+cache_types = [type_prom, type_crom, type_vrom, type_srom, type_mrom, type_bram]
+cache_keys = {}     # name -> [stat hash, key, data hashes] of the last run
+
+
+def ReadCache (fn: str) -> list:
+    try:
+        with open (fn, "rt", encoding='utf-8') as f:
+            return f.read ().splitlines ()
+    except OSError:
+        return []
+
+
+def WriteCache (fn: str, s: str):
+    os.makedirs (os.path.dirname (fn), exist_ok=True)
+    with open (fn + '.tmp', "wt", encoding='utf-8') as f:
+        f.write (s)
+    os.replace (fn + '.tmp', fn)
+
+
+def RemoveCache (fn: str):
+    if os.path.exists (fn):
+        os.remove (fn)
+
+
+def StatHash (name: str) -> str:
+    s = []
+    for f in cache_files:
+        try:
+            st = os.stat (os.path.join ('../Games', name, f))
+            s.append ('%s %x %x\n' % (f, st.st_size, st.st_mtime_ns))
+        except OSError:
+            s.append ('%s -\n' % (f))
+    return hashlib.sha1 (''.join (s).encode ('utf-8')).hexdigest ()
+
+
+def HashGame (ix: int):
+    r = ROM [ix]
+    s = '%s\n%s\n%x\n%i %i %i\n' % (r.name, r.mname, r.vblk_addr, r.mode_bsw, r.mode_gra, r.mode_aud)
+    for typ, a in zip (cache_types, (r.prom, r.crom, r.vrom, r.srom, r.mrom, r.bram)):
+        r.hash [typ] = hashlib.sha1 (a).hexdigest ()
+        s = s + '%x %s\n' % (len (a), r.hash [typ])
+    r.key = hashlib.sha1 (s.encode ('utf-8')).hexdigest ()
+
+
+# the menu is hashed when it is first needed, after PatchMenu
+def GameKey (ix: int) -> str:
+    if not ROM [ix].key:
+        HashGame (ix)
+    return ROM [ix].key
+
+
+def DataKey (ix: int, typ: int) -> str:
+    GameKey (ix)
+    return ROM [ix].hash [typ]
+
+
+# Build id of an image for the delta lists: CRC32 of its sector CRC32s,
+# little endian
+def BuildId (crcs: list) -> int:
+    return zlib.crc32 (b''.join (c.to_bytes (4, 'little') for c in crcs))
+
+
 def GetPName (n: int):
     ROM [n].pname = " " * 16
     prom = PSwap (ROM [n].prom)
@@ -230,9 +372,9 @@ def POP (fn: str, pos: int, mask: int, rom:bytes, typ: int):
 
     ix = len(rom)
     if ((typ != type_bram) and (typ != type_vrom)):
-        tmp = bytes([0xFF for x in range(l)])
+        tmp = b'\xff' * l
     else:
-        tmp = bytes([0x00 for x in range(l)])
+        tmp = bytes(l)
     rom = bytearray(rom + tmp)
 
     if ff:
@@ -245,6 +387,46 @@ def POP (fn: str, pos: int, mask: int, rom:bytes, typ: int):
     return (pos, rom)
 
 
+# File data of one game. Runs on the worker pool; the layout positions are
+# assigned afterwards in list order, so they do not depend on which game
+# finishes loading first.
+def LoadGame (ix: int):
+    dummy_pos = 0
+    # before reading, so a file changed meanwhile is hashed next time
+    stat = StatHash (ROM [ix].name)
+
+    fn = os.path.join('../Games', ROM [ix].name, 'prom')
+    (_, ROM[ix].prom) = POP (fn, dummy_pos, prom_mask, ROM[ix].prom, type_prom)
+    fn = os.path.join('../Games', ROM [ix].name, 'prom1')
+    (_, ROM[ix].prom) = POP (fn, dummy_pos, prom_mask, ROM[ix].prom, type_prom1)
+
+    ROM [ix].ngh = (ROM [ix].prom [0x109] << 8) + ROM [ix].prom [0x108]
+    GetPName (ix)
+
+    fn = os.path.join('../Games', ROM [ix].name, 'crom0')
+    (_, ROM[ix].crom) = POP (fn, dummy_pos, crom_mask, ROM[ix].crom, type_crom)
+
+    fn = os.path.join('../Games', ROM [ix].name, 'vroma0')
+    (_, ROM[ix].vrom) = POP (fn, dummy_pos, vrom_mask, ROM[ix].vrom, type_vrom)
+
+    fn = os.path.join('../Games', ROM [ix].name, 'srom')
+    (_, ROM[ix].srom) = POP (fn, dummy_pos, srom_mask, ROM[ix].srom, type_srom)
+
+    fn = os.path.join('../Games', ROM [ix].name, 'm1rom')
+    (_, ROM[ix].mrom) = POP (fn, dummy_pos, mrom_mask, ROM[ix].mrom, type_mrom)
+
+    fn = os.path.join('../Games', ROM [ix].name, 'bram')
+    (_, ROM[ix].bram) = POP (fn, dummy_pos, 0x10000, ROM[ix].bram, type_bram)
+
+    c = cache_keys.get (ROM [ix].name)
+    if c and c [0] == stat:
+        ROM [ix].key = c [1]
+        ROM [ix].hash = dict (zip (cache_types, c [2:8]))
+    else:
+        HashGame (ix)
+    return stat
+
+
 def Import (games: str):
     global ROM
     rom_index = 0
@@ -298,13 +480,9 @@ def Import (games: str):
         # print ('Info: ', ROM [ix].mname + ' imported')
         rom_index += 1
 
+    # the game's data is loaded by LoadGame
     def import1 (s: str):
         nonlocal rom_index
-        global crom_pos
-        global prom_pos
-        global mrom_pos
-        global srom_pos
-        global vrom_pos
 
         ix = len(ROM)
         ROM.append(TROM())
@@ -313,11 +491,6 @@ def Import (games: str):
         ROM [ix].name = s
         ROM [ix].mname = GetMenu (s)
         ROM [ix].vblk_addr = GetVBlank (s)
-        ROM [ix].crom_addr = crom_pos
-        ROM [ix].prom_addr = prom_pos
-        ROM [ix].mrom_addr = mrom_pos
-        ROM [ix].srom_addr = srom_pos
-        ROM [ix].vrom_addr = vrom_pos
         ROM [ix].crom = bytes()
         ROM [ix].prom = bytes()
         ROM [ix].mrom = bytes()
@@ -326,36 +499,34 @@ def Import (games: str):
 
         ROM [ix].mode_bsw, ROM [ix].mode_gra, ROM [ix].mode_aud = GetMode(s)
 
-        dummy_pos = 0
-
-        fn = os.path.join('../Games', ROM [ix].name, 'prom')
-        (prom_pos, ROM[ix].prom) = POP (fn, prom_pos, prom_mask, ROM[ix].prom, type_prom)
-        fn = os.path.join('../Games', ROM [ix].name, 'prom1')
-        (prom_pos, ROM[ix].prom) = POP (fn, prom_pos, prom_mask, ROM[ix].prom, type_prom1)
-
-        ROM [ix].ngh = (ROM [ix].prom [0x109] << 8) + ROM [ix].prom [0x108]
-        GetPName (ix)
-
-        fn = os.path.join('../Games', ROM [ix].name, 'crom0')
-        (crom_pos, ROM[ix].crom) = POP (fn, crom_pos, crom_mask, ROM[ix].crom, type_crom)
-
-        fn = os.path.join('../Games', ROM [ix].name, 'vroma0')
-        (vrom_pos, ROM[ix].vrom) = POP (fn, vrom_pos, vrom_mask, ROM[ix].vrom, type_vrom)
-
-        fn = os.path.join('../Games', ROM [ix].name, 'srom')
-        (srom_pos, ROM[ix].srom) = POP (fn, srom_pos, srom_mask, ROM[ix].srom, type_srom)
-
-        fn = os.path.join('../Games', ROM [ix].name, 'm1rom')
-        (mrom_pos, ROM[ix].mrom) = POP (fn, mrom_pos, mrom_mask, ROM[ix].mrom, type_mrom)
-
-        fn = os.path.join('../Games', ROM [ix].name, 'bram')
-        (_, ROM[ix].bram) = POP (fn, dummy_pos, 0x10000, ROM[ix].bram, type_bram)
-
         # print ('Info: ', ROM [ix].mname + ' imported')
         rom_index = rom_index + 1
 
+    def place1 (ix: int):
+        global crom_pos
+        global prom_pos
+        global mrom_pos
+        global srom_pos
+        global vrom_pos
+
+        ROM [ix].crom_addr = crom_pos
+        ROM [ix].prom_addr = prom_pos
+        ROM [ix].mrom_addr = mrom_pos
+        ROM [ix].srom_addr = srom_pos
+        ROM [ix].vrom_addr = vrom_pos
+        crom_pos = crom_pos + len (ROM [ix].crom)
+        prom_pos = prom_pos + len (ROM [ix].prom)
+        mrom_pos = mrom_pos + len (ROM [ix].mrom)
+        srom_pos = srom_pos + len (ROM [ix].srom)
+        vrom_pos = vrom_pos + len (ROM [ix].vrom)
+
     print ('Import: ', end="")
 
+    for s in ReadCache (os.path.join (cache_dir, 'games.txt')):
+        c = s.split (' ', 8)
+        if len (c) == 9:
+            cache_keys [c [8]] = c [0:8]
+
     import_menu()
 
     with open(games, "rt") as f:
@@ -366,7 +537,16 @@ def Import (games: str):
             if s[0] == '#':
                 continue
             import1(s)
+
+    # file reads release the GIL, so threads overlap the I/O of several
+    # games; map() returns them in list order
+    c = []
+    with concurrent.futures.ThreadPoolExecutor(max_workers=os.cpu_count()) as pool:
+        for ix, stat in zip(range(1, len(ROM)), pool.map(LoadGame, range(1, len(ROM)))):
+            place1(ix)
+            c.append (' '.join ([stat, ROM [ix].key] + [ROM [ix].hash [t] for t in cache_types] + [ROM [ix].name]) + '\n')
             print('.', end='', flush=True)
+    WriteCache (os.path.join (cache_dir, 'games.txt'), ''.join (c))
     print ()
     print ()
 
@@ -434,15 +614,160 @@ def GenIX():
 
 def GenROM():
 
-    def SaveROM (fn: str, rom_1: int, rom_max: int, typ: int):
+    # Streams a ROM to its output file(s). Game data and the 0xFF fill after
+    # the last game are collected in one flash sector, which is written out
+    # and checksummed when it is full. A new part file is started every rom_1
+    # bytes, so only the sector is held in memory. Manifest and delta list
+    # formats see Dumpers/Firmware/src/User/Src/manifest.c and delta.c
+    # With scr, each sector is put into chip bus order before it is written
+    # and the manifest is flagged, which needs a manifest. A chunk whose
+    # recipe (see cache_dir) did not change is skipped in an existing part.
+    # The delta list of a part names the sectors that differ from each of
+    # the last builds (see dlt_bases), so it still applies to a cart that
+    # was programmed a few runs ago.
+    class ROMWriter:
+
+        def __init__ (self, fn: str, rom_1: int, rom_max: int, sector: int, man: bool, scr):
+            self.fn = fn
+            self.rom_1 = rom_1
+            self.rom_max = rom_max
+            self.sector = sector
+            self.with_man = man
+            self.scr = scr if man else None
+            self.chunk = sector
+            self.buf = bytearray (self.chunk)
+            self.ff = memoryview (b'\xff' * self.chunk)
+            self.n = 0      # bytes in buf
+            self.pos = 0    # ROM offset after buf
+            self.fx = 0
+            self.man = None
+            self.recipe = []
+            self.written = 0
+            self.NextPart ()
+
+        def NextPart (self):
+            name = self.fn
+            if (self.rom_1 != self.rom_max):
+                self.fx = self.fx + 1
+                name = self.fn + '-%i' % (self.fx)
+            self.part_end = min (self.pos + self.rom_1, self.rom_max)
+            flags = man_flag_scrambled if self.scr else 0
+            header = 'VTXRCP 2 %x %x %x' % (self.chunk, self.part_end - self.pos, flags)
+            self.rcp_name = os.path.join (cache_dir, 'rom', os.path.basename (name) + '.rcp')
+            self.rcp = [header]
+            self.rcp_old = ReadCache (self.rcp_name)
+            if not (self.rcp_old and os.path.exists (name) and self.rcp_old [0] == header + self.FileStat (name)):
+                self.rcp_old = []
+            RemoveCache (self.rcp_name)
+            self.bld_name = os.path.join (cache_dir, 'rom', os.path.basename (name) + '.bld')
+            self.bld_old = ReadCache (self.bld_name)
+            RemoveCache (self.bld_name)
+            RemoveCache (name + '.dlt')
+            self.f = open (name, "r+b" if self.rcp_old else "wb")
+            self.name = name
+            self.crcs = []
+            if self.with_man:
+                self.man = open (name + '.man', "wt", encoding='utf-8')
+                self.man.write ('VTXMAN 1 %x %x %x\n' % (self.sector, self.part_end - self.pos, flags))
+
+        @staticmethod
+        def FileStat (name: str) -> str:
+            st = os.stat (name)
+            return ' %x %x' % (st.st_size, st.st_mtime_ns)
+
+        def ClosePart (self):
+            self.f.close ()
+            self.rcp [0] = self.rcp [0] + self.FileStat (self.name)
+            if self.man:
+                self.man.close ()
+            header = 'VTXBLD 1 %x %x' % (self.sector, len (self.crcs) * self.sector)
+            build = BuildId (self.crcs)
+            bld = [header, ' '.join ('%08x' % c for c in self.crcs)]
+            d = ['VTXDLT 1 %x %x %08x\n' % (self.sector, len (self.crcs) * self.sector, build)]
+            d.append ('%08x 0\n' % (build))
+            if self.bld_old and self.bld_old [0] == header:
+                for s in self.bld_old [1:]:
+                    crcs = [int (c, 16) for c in s.split (' ')]
+                    if (len (bld) > dlt_bases) or (len (crcs) != len (self.crcs)) or (BuildId (crcs) == build):
+                        continue
+                    bld.append (s)
+                    runs = []
+                    for k in range (len (crcs)):
+                        if crcs [k] == self.crcs [k]:
+                            continue
+                        if runs and runs [-1] [0] + runs [-1] [1] == k:
+                            runs [-1] [1] = runs [-1] [1] + 1
+                        else:
+                            runs.append ([k, 1])
+                    d.append ('%08x %x\n' % (BuildId (crcs), len (runs)))
+                    d.extend ('%x %x\n' % (k, n) for k, n in runs)
+            with open (self.name + '.dlt', "wt", encoding='utf-8') as f:
+                f.write (''.join (d))
+            WriteCache (self.bld_name, ''.join (s + '\n' for s in bld))
+            WriteCache (self.rcp_name, ''.join (s + '\n' for s in self.rcp))
+
+        def Flush (self):
+            recipe = hashlib.sha1 (''.join (self.recipe).encode ('utf-8')).hexdigest ()
+            self.recipe = []
+            k = len (self.rcp)
+            old = self.rcp_old [k].split (' ') if k < len (self.rcp_old) else None
+            if old and old [0] == recipe:
+                # same data as in the last run
+                self.f.seek (self.n, 1)
+                crc = int (old [1], 16)
+                blank = int (old [2])
+                sha = old [3]
+            else:
+                if self.scr:
+                    # parts are whole sectors, n is always the full chunk here
+                    self.scr.Apply (self.buf)
+                sha = hashlib.sha1 (memoryview (self.buf) [0:self.n]).hexdigest ()
+                if old and old [3] == sha:
+                    self.f.seek (self.n, 1)
+                else:
+                    self.f.write (memoryview (self.buf) [0:self.n])
+                    self.written = self.written + self.n
+                # the last sector of a part is padded like on the programmer
+                self.buf [self.n:] = self.ff [self.n:]
+                blank = 1 if self.buf.count (0xFF) == self.sector else 0
+                crc = zlib.crc32 (self.buf)
+            if self.man:
+                self.man.write ('%08x %i\n' % (crc, blank))
+            self.crcs.append (crc)
+            self.rcp.append ('%s %08x %i %s' % (recipe, crc, blank, sha))
+            self.n = 0
+            if self.pos == self.part_end:
+                self.ClosePart ()
+                if self.pos < self.rom_max:
+                    self.NextPart ()
+
+        # data = None writes 0xFF; key names the data for the recipe;
+        # returns the number of bytes that did not fit
+        def Put (self, data, l1: int, key: str = 'ff') -> int:
+            if data is not None:
+                data = memoryview (data)
+            ix = 0
+            while (ix < l1) and (self.pos < self.rom_max):
+                l = min (l1 - ix, self.chunk - self.n, self.part_end - self.pos)
+                src = self.ff [0:l] if data is None else data [ix:ix + l]
+                self.recipe.append ('%s %x %x\n' % (key, ix, l))
+                self.buf [self.n:self.n + l] = src
+                self.n = self.n + l
+                self.pos = self.pos + l
+                ix = ix + l
+                if (self.n == self.chunk) or (self.pos == self.part_end):
+                    self.Flush ()
+            return l1 - ix
+
+        def Close (self):
+            self.Put (None, self.rom_max - self.pos)
+            if self.rom_max == 0:
+                self.ClosePart ()
+
+    def SaveROM (fn: str, rom_1: int, rom_max: int, typ: int, sector: int, man: bool, scr = None):
         ff = False
-    
-        value: numpy.uint8 = 0xFF
-        rom_arr = bytearray([value for x in range(rom_max)])
-        
-        #ix: offset of current rom/game in the to be written output file 
-        ix = 0
-        
+        w = ROMWriter (fn, rom_1, rom_max, sector, man, scr)
+
         #i: number of rom/game processed, e.g.: i=0 => menu 
         for i in range(len (ROM)):
             if (ROM [i].name != 'menu'):
@@ -463,42 +788,28 @@ def GenROM():
             if typ == type_srom: in_arr = ROM [i].srom
             if typ == type_mrom: in_arr = ROM [i].mrom
             l1 = len (in_arr)
-            if (l1 > 0):
-                if ((ix + l1) <= rom_max):
-                    rom_arr [ix:ix + l1] = in_arr
-                else:
-                    l2 = min(ix + l1, rom_max) - ix
-                    rom_arr [ix:ix + l2] = in_arr[0:l2]
-                    if (not ff):
-                        WriteLog ('Error: ' + fn + ' is full!')
-                        ff = True
-            ix = ix + l1
+            if (l1 > 0) and (w.Put (in_arr, l1, DataKey (i, typ)) > 0):
+                if (not ff):
+                    WriteLog ('Error: ' + fn + ' is full!')
+                    ff = True
             print ('.', end='', flush=True)
-        if (rom_1 != rom_max):
-            ix = 0
-            fx = 1
-            while ix < rom_max:
-
-                with open(fn + '-%i' % (fx), "wb") as f:
-                    f.write(rom_arr [ix:ix + rom_1])
-                ix = ix + rom_1
-                fx = fx + 1
-        else:
-            with open (fn, "wb") as f:
-                f.write(rom_arr)
-        rom_arr = bytes()
+        w.Close ()
+        return w.written
 
     print ('GenROM: ', end="")
 
     os.makedirs ('ROM', exist_ok=True)
 
-    SaveROM ('ROM/prom', prom_max // 3, prom_max, type_prom)
-    SaveROM ('ROM/crom', crom_max // 2, crom_max + crom_extend, type_crom)
-    SaveROM ('ROM/vrom', vrom_max, vrom_max, type_vrom)
-    SaveROM ('ROM/srom', srom_max, srom_max, type_srom)
-    SaveROM ('ROM/mrom', mrom_max, mrom_max, type_mrom)
+    p_scr = TScramble (p_scr_bits, False) if prescramble else None
+    c_scr = TScramble (cv_scr_bits, True) if prescramble else None
+    written = SaveROM ('ROM/prom', prom_max // 3, prom_max, type_prom, 0x40000, True, p_scr)
+    written += SaveROM ('ROM/crom', crom_max // 2, crom_max + crom_extend, type_crom, 0x80000, True, c_scr)
+    written += SaveROM ('ROM/vrom', vrom_max, vrom_max, type_vrom, 0x80000, True)
+    written += SaveROM ('ROM/srom', srom_max, srom_max, type_srom, sm_sector, False)
+    written += SaveROM ('ROM/mrom', mrom_max, mrom_max, type_mrom, sm_sector, False)
 
     print ()
+    print ('%i kB written' % (written >> 10))
     print ()
 
 
@@ -633,6 +944,8 @@ def PatchMenu():
         prom [0xE0697] = w1 - 1
 
     ROM [0].prom = PSwap (prom)
+    ROM [0].key = ""
+    ROM [0].hash = {}
 
     del prom
 
@@ -645,6 +958,108 @@ def GenMAME():
         with open(fn, "wb") as f:
             f.write(arr)
 
+    # Files and softwarelist entry of one game. Runs on the worker pool:
+    # file writes and hashing release the GIL, so games are processed in
+    # parallel. The entries are written in list order. A game whose key is
+    # the same as when its files were written is taken from the cache.
+    def MAMEGame (i: int) -> str:
+        x = []
+
+        fn = os.path.join('MAME/roms', ROM [i].name)
+        key = GameKey (i)
+        cn = os.path.join (cache_dir, 'mame', ROM [i].name + '.xml')
+        c = ReadCache (cn)
+        if os.path.isdir (fn) and c and c [0] == key:
+            return ''.join (s + '\n' for s in c [1:])
+        RemoveCache (cn)
+        os.makedirs (fn, exist_ok=True)
+
+        vroma = bytearray()
+        vromb = bytearray()
+        if (ROM [i].mode_aud == 1): 
+              (vroma, vromb) = VSplit (ROM [i].vrom)
+
+        SaveMAME (os.path.join(fn, 'prom'), ROM [i].prom)
+        SaveMAME (os.path.join(fn, 'srom'), ROM [i].srom)
+        SaveMAME (os.path.join(fn, 'mrom'), ROM [i].mrom)
+        if (len (vroma) > 0):
+            SaveMAME (os.path.join(fn, 'vroma'), vroma)
+            SaveMAME (os.path.join(fn, 'vromb'), vromb)
+        elif (len (ROM [i].vrom) > 0):
+            SaveMAME (os.path.join(fn, 'vrom'), ROM [i].vrom)
+        if (len (ROM [i].crom) > 0):
+            crom = CSwap (ROM [i].crom)
+            SaveMAME (os.path.join(fn, 'crom'), crom)
+        else:
+            crom = bytes()
+
+        size_c = 0x4000000
+        if (len (crom) <= 0x4000000): size_c = 0x4000000
+        if (len (crom) <= 0x2000000): size_c = 0x2000000
+        if (len (crom) <= 0x1000000): size_c = 0x1000000
+        if (len (crom) <= 0x0800000): size_c = 0x0800000
+        if (len (crom) <= 0x0400000): size_c = 0x0400000
+        if (len (crom) <= 0x0200000): size_c = 0x0200000
+        if (len (crom) <= 0x0100000): size_c = 0x0100000
+
+        crc_p = zlib.crc32((ROM [i].prom))
+        crc_c = zlib.crc32((crom))
+        crc_v = zlib.crc32((ROM [i].vrom))
+        crc_va = zlib.crc32((vroma))
+        crc_vb = zlib.crc32((vromb))
+        crc_s = zlib.crc32((ROM [i].srom))
+        crc_m = zlib.crc32((ROM [i].mrom))
+
+        sha_p = hashlib.sha1((ROM [i].prom)).hexdigest().upper()
+        sha_c = hashlib.sha1((crom)).hexdigest().upper()
+        sha_v = hashlib.sha1((ROM [i].vrom)).hexdigest().upper()
+        sha_va = hashlib.sha1((vroma)).hexdigest().upper()
+        sha_vb = hashlib.sha1((vromb)).hexdigest().upper()
+        sha_s = hashlib.sha1((ROM [i].srom)).hexdigest().upper()
+        sha_m = hashlib.sha1((ROM [i].mrom)).hexdigest().upper()
+
+        x.append('\t<software name="' + ROM [i].name + '">\n')
+        x.append('\t\t<description>' + ROM [i].mname + '</description>\n')
+        x.append('\t\t<year>2023</year>\n')
+        x.append('\t\t<publisher>vortex</publisher>\n')
+        x.append('\t\t<sharedfeat name="release" value="MVS,AES" />\n')
+        x.append('\t\t<sharedfeat name="compatibility" value="MVS,AES" />\n')
+        x.append('\t\t<part name="cart" interface="neo_cart">\n')
+        x.append('\t\t\t<dataarea name="maincpu" width="16" endianness="big" size="0x%08X' % (len (ROM [i].prom)) + '">\n')
+        x.append('\t\t\t\t<rom loadflag="load16_word_swap" name="prom" offset="0x000000" size="0x%08X"' % (len (ROM [i].prom)) + ' crc="%08X"' % crc_p + ' sha1="' + sha_p + '" />\n')
+        x.append('\t\t\t</dataarea>\n')
+        x.append('\t\t\t<dataarea name="fixed" size="0x040000">\n')
+        x.append('\t\t\t\t<rom name="srom" offset="0x000000" size="0x%08X' % (len (ROM [i].srom)) + '" crc="%08X"' % crc_s + ' sha1="' + sha_s + '" />\n')
+        x.append('\t\t\t</dataarea>\n')
+        x.append('\t\t\t<dataarea name="audiocpu" size="0x%08X"' % (len (ROM [i].mrom)) + '>\n')
+        x.append('\t\t\t\t<rom name="mrom" offset="0x000000" size="0x%08X' % (len (ROM [i].mrom)) + '" crc="%08X"' % crc_m + ' sha1="' + sha_m + '" />\n')
+        x.append('\t\t\t</dataarea>\n')
+        if (len (vroma) > 0):
+            x.append('\t\t\t<dataarea name="ymsnd:adpcma" size="0x%08X">\n' % (len (vroma)))
+            x.append('\t\t\t\t<rom name="vroma" offset="0x000000" size="0x%08X' % (len (vroma)) + '" crc="%08X"' % crc_va + ' sha1="' + sha_va + '" />\n')
+            x.append('\t\t\t</dataarea>\n')
+            x.append('\t\t\t<dataarea name="ymsnd:adpcmb" size="0x%08X">\n' % (len (vromb)))
+            x.append('\t\t\t\t<rom name="vromb" offset="0x000000" size="0x%08X' % (len (vromb)) + '" crc="%08X"' % crc_vb + ' sha1="' + sha_vb + '" />\n')
+            x.append('\t\t\t</dataarea>\n')
+        else:
+            if (len (ROM [i].vrom) > 0):
+                x.append('\t\t\t<dataarea name="ymsnd:adpcma" size="0x%08X">\n' % (len (ROM [i].vrom)))
+                x.append('\t\t\t\t<rom name="vrom" offset="0x000000" size="0x%08X' % (len (ROM [i].vrom)) + '" crc="%08X"' % crc_v + ' sha1="' + sha_v + '" />\n')
+                x.append('\t\t\t</dataarea>\n')
+        if (len (ROM [i].crom) > 0):
+            x.append('\t\t\t<dataarea name="sprites" size="0x%08X">\n' % (size_c))
+            x.append('\t\t\t\t<rom loadflag="load8_byte" name="crom" offset="0x000000" size="0x%08X' % (len (ROM [i].crom)) + '" crc="%08X"' % crc_c + ' sha1="' + sha_c + '" />\n')
+            x.append('\t\t\t</dataarea>\n')
+        else:
+            x.append('\t\t\t<dataarea name="sprites" size="0x%08X">\n' % (size_c))
+            x.append('\t\t\t</dataarea>\n')
+        x.append('\t\t</part>\n')
+        x.append('\t</software>\n')
+        x.append('\t\n')
+
+        WriteCache (cn, key + '\n' + ''.join(x))
+        return ''.join(x)
+
     print ('SaveMAME: ', end="")
 
     os.makedirs ('MAME', exist_ok=True)
@@ -657,98 +1072,11 @@ def GenMAME():
         f.write('<softwarelist name="neogeo" description="SNK Neo-Geo cartridges">\n')
         f.write('\n')
 
-        for i  in range (len (ROM)):
-            fn = os.path.join('MAME/roms', ROM [i].name)
-            os.makedirs (fn, exist_ok=True)
-    
-            vroma = bytearray()
-            vromb = bytearray()
-            if (ROM [i].mode_aud == 1): 
-                  (vroma, vromb) = VSplit (ROM [i].vrom)
-    
-            SaveMAME (os.path.join(fn, 'prom'), ROM [i].prom)
-            SaveMAME (os.path.join(fn, 'srom'), ROM [i].srom)
-            SaveMAME (os.path.join(fn, 'mrom'), ROM [i].mrom)
-            if (len (vroma) > 0):
-                SaveMAME (os.path.join(fn, 'vroma'), vroma)
-                SaveMAME (os.path.join(fn, 'vromb'), vromb)
-            elif (len (ROM [i].vrom) > 0):
-                SaveMAME (os.path.join(fn, 'vrom'), ROM [i].vrom)
-            if (len (ROM [i].crom) > 0):
-                crom = CSwap (ROM [i].crom)
-                SaveMAME (os.path.join(fn, 'crom'), crom)
-            else:
-                crom = bytes()
-    
-            size_c = 0x4000000
-            if (len (crom) <= 0x4000000): size_c = 0x4000000
-            if (len (crom) <= 0x2000000): size_c = 0x2000000
-            if (len (crom) <= 0x1000000): size_c = 0x1000000
-            if (len (crom) <= 0x0800000): size_c = 0x0800000
-            if (len (crom) <= 0x0400000): size_c = 0x0400000
-            if (len (crom) <= 0x0200000): size_c = 0x0200000
-            if (len (crom) <= 0x0100000): size_c = 0x0100000
-    
-            crc_p = zlib.crc32((ROM [i].prom))
-            crc_c = zlib.crc32((crom))
-            crc_v = zlib.crc32((ROM [i].vrom))
-            crc_va = zlib.crc32((vroma))
-            crc_vb = zlib.crc32((vromb))
-            crc_s = zlib.crc32((ROM [i].srom))
-            crc_m = zlib.crc32((ROM [i].mrom))
-    
-            sha_p = hashlib.sha1((ROM [i].prom)).hexdigest().upper()
-            sha_c = hashlib.sha1((crom)).hexdigest().upper()
-            sha_v = hashlib.sha1((ROM [i].vrom)).hexdigest().upper()
-            sha_va = hashlib.sha1((vroma)).hexdigest().upper()
-            sha_vb = hashlib.sha1((vromb)).hexdigest().upper()
-            sha_s = hashlib.sha1((ROM [i].srom)).hexdigest().upper()
-            sha_m = hashlib.sha1((ROM [i].mrom)).hexdigest().upper()
-    
-            f.write('\t<software name="' + ROM [i].name + '">\n')
-            f.write('\t\t<description>' + ROM [i].mname + '</description>\n')
-            f.write('\t\t<year>2023</year>\n')
-            f.write('\t\t<publisher>vortex</publisher>\n')
-            f.write('\t\t<sharedfeat name="release" value="MVS,AES" />\n')
-            f.write('\t\t<sharedfeat name="compatibility" value="MVS,AES" />\n')
-            f.write('\t\t<part name="cart" interface="neo_cart">\n')
-            f.write('\t\t\t<dataarea name="maincpu" width="16" endianness="big" size="0x%08X' % (len (ROM [i].prom)) + '">\n')
-            f.write('\t\t\t\t<rom loadflag="load16_word_swap" name="prom" offset="0x000000" size="0x%08X"' % (len (ROM [i].prom)) + ' crc="%08X"' % crc_p + ' sha1="' + sha_p + '" />\n')
-            f.write('\t\t\t</dataarea>\n')
-            f.write('\t\t\t<dataarea name="fixed" size="0x040000">\n')
-            f.write('\t\t\t\t<rom name="srom" offset="0x000000" size="0x%08X' % (len (ROM [i].srom)) + '" crc="%08X"' % crc_s + ' sha1="' + sha_s + '" />\n')
-            f.write('\t\t\t</dataarea>\n')
-            f.write('\t\t\t<dataarea name="audiocpu" size="0x%08X"' % (len (ROM [i].mrom)) + '>\n')
-            f.write('\t\t\t\t<rom name="mrom" offset="0x000000" size="0x%08X' % (len (ROM [i].mrom)) + '" crc="%08X"' % crc_m + ' sha1="' + sha_m + '" />\n')
-            f.write('\t\t\t</dataarea>\n')
-            if (len (vroma) > 0):
-                f.write('\t\t\t<dataarea name="ymsnd:adpcma" size="0x%08X">\n' % (len (vroma)))
-                f.write('\t\t\t\t<rom name="vroma" offset="0x000000" size="0x%08X' % (len (vroma)) + '" crc="%08X"' % crc_va + ' sha1="' + sha_va + '" />\n')
-                f.write('\t\t\t</dataarea>\n')
-                f.write('\t\t\t<dataarea name="ymsnd:adpcmb" size="0x%08X">\n' % (len (vromb)))
-                f.write('\t\t\t\t<rom name="vromb" offset="0x000000" size="0x%08X' % (len (vromb)) + '" crc="%08X"' % crc_vb + ' sha1="' + sha_vb + '" />\n')
-                f.write('\t\t\t</dataarea>\n')
-            else:
-                if (len (ROM [i].vrom) > 0):
-                    f.write('\t\t\t<dataarea name="ymsnd:adpcma" size="0x%08X">\n' % (len (ROM [i].vrom)))
-                    f.write('\t\t\t\t<rom name="vrom" offset="0x000000" size="0x%08X' % (len (ROM [i].vrom)) + '" crc="%08X"' % crc_v + ' sha1="' + sha_v + '" />\n')
-                    f.write('\t\t\t</dataarea>\n')
-            if (len (ROM [i].crom) > 0):
-                f.write('\t\t\t<dataarea name="sprites" size="0x%08X">\n' % (size_c))
-                f.write('\t\t\t\t<rom loadflag="load8_byte" name="crom" offset="0x000000" size="0x%08X' % (len (ROM [i].crom)) + '" crc="%08X"' % crc_c + ' sha1="' + sha_c + '" />\n')
-                f.write('\t\t\t</dataarea>\n')
-            else:
-                f.write('\t\t\t<dataarea name="sprites" size="0x%08X">\n' % (size_c))
-                f.write('\t\t\t</dataarea>\n')
-            f.write('\t\t</part>\n')
-            f.write('\t</software>\n')
-            f.write('\t\n')
-    
-            del crom
-
-            print ('.', end='', flush=True)
+        with concurrent.futures.ThreadPoolExecutor(max_workers=os.cpu_count()) as pool:
+            for s in pool.map(MAMEGame, range (len (ROM))):
+                f.write(s)
+                print ('.', end='', flush=True)
 
-    
         f.write('</softwarelist>\n')
 
     print ()
@@ -758,6 +1086,7 @@ def GenMAME():
 def main():
     global _sys
     global crom_extend
+    global prescramble
     global logname
 
     parser = argparse.ArgumentParser(prog='VTXCart', description='SNK MultiCart Compiler v1.01 (c) Vortex ''2023')
@@ -768,11 +1097,13 @@ def main():
     parser.add_argument('--patchmenu', action='store_true')
     parser.add_argument('--genmame', action='store_true')
     parser.add_argument('--genrom', action='store_true')
+    parser.add_argument('--prescramble', action='store_true')
 
     args = parser.parse_args()
 
     _sys = args.sys
     crom_extend = 0x40000000 if args.c3g else 0
+    prescramble = args.prescramble
 
     fn = args.filename
     if not os.path.exists(fn):
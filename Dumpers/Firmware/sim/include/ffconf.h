@@ -0,0 +1,5 @@
+/* firmware FatFs configuration, plus f_mkfs() to format new card images */
+#include "../../src/User/Inc/ffconf.h"
+
+#undef FF_USE_MKFS
+#define FF_USE_MKFS 1
@@ -0,0 +1,61 @@
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/*
+ * Replaces User/Inc/main.h for the host build: same project headers, but
+ * the HAL, BSP and USB stack are replaced by stm32_sim.h.
+ */
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "defines.h"
+
+/* no timer/DMA engine in the simulator, dumps use CPU read cycles */
+#undef BUS_DMA_READ
+
+/* no linker sections on the host */
+#undef AXI_BUFFER
+#undef D2SRAM_BUFFER
+#define AXI_BUFFER
+#define D2SRAM_BUFFER
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "stm32_sim.h"
+
+#include "ff.h"
+#include "stream.h"
+#include "scramble.h"
+#include "prof.h"
+#include "crc32.h"
+#include "manifest.h"
+#include "hash.h"
+#include "journal.h"
+#include "delta.h"
+#include "status.h"
+
+int LCD_vprintf(int c, char *format, va_list ap);
+int LCD_printf(int c, char *format, ...);
+int LCD_xyprintf(int x, int y, int c, char *format, ...);
+int LCD_Status(int y, int c, char *format, ...);
+void LCD_Clear(void);
+
+#include "tools.h"
+
+#include "variables.h"
+
+#include "P.h"
+#include "SM.h"
+#include "CV.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAIN_H */
@@ -0,0 +1,146 @@
+#ifndef __STM32_SIM_H
+#define __STM32_SIM_H
+
+/*
+ * Minimal stand-ins for the CMSIS/HAL definitions used by the chip drivers.
+ *
+ * GPIOx expands to a function call so every register access is seen by the
+ * simulator: pending BSRR writes are applied, simulated time advances by one
+ * bus access and the flash models update the data lines in IDR.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+typedef struct {
+  uint32_t MODER;
+  uint32_t OTYPER;
+  uint32_t OSPEEDR;
+  uint32_t PUPDR;
+  uint32_t IDR;
+  uint32_t ODR;
+  uint32_t BSRR;
+  uint32_t LCKR;
+  uint32_t AFR[2];
+} GPIO_TypeDef;
+
+GPIO_TypeDef *sim_gpio(int port);
+
+#define GPIOA sim_gpio(0)
+#define GPIOB sim_gpio(1)
+#define GPIOC sim_gpio(2)
+#define GPIOD sim_gpio(3)
+#define GPIOE sim_gpio(4)
+
+typedef struct {
+  uint32_t Pin;
+  uint32_t Mode;
+  uint32_t Pull;
+  uint32_t Speed;
+  uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+#define GPIO_PIN_0   0x0001U
+#define GPIO_PIN_1   0x0002U
+#define GPIO_PIN_2   0x0004U
+#define GPIO_PIN_3   0x0008U
+#define GPIO_PIN_4   0x0010U
+#define GPIO_PIN_5   0x0020U
+#define GPIO_PIN_6   0x0040U
+#define GPIO_PIN_7   0x0080U
+#define GPIO_PIN_8   0x0100U
+#define GPIO_PIN_9   0x0200U
+#define GPIO_PIN_10  0x0400U
+#define GPIO_PIN_11  0x0800U
+#define GPIO_PIN_12  0x1000U
+#define GPIO_PIN_13  0x2000U
+#define GPIO_PIN_14  0x4000U
+#define GPIO_PIN_15  0x8000U
+
+#define GPIO_MODE_INPUT       0U
+#define GPIO_MODE_OUTPUT_PP   1U
+#define GPIO_NOPULL           0U
+#define GPIO_PULLUP           1U
+#define GPIO_PULLDOWN         2U
+#define GPIO_SPEED_FREQ_LOW       0U
+#define GPIO_SPEED_FREQ_MEDIUM    1U
+#define GPIO_SPEED_FREQ_HIGH      2U
+#define GPIO_SPEED_FREQ_VERY_HIGH 3U
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init);
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE() do { } while(0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE() do { } while(0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE() do { } while(0)
+#define __HAL_RCC_GPIOD_CLK_ENABLE() do { } while(0)
+#define __HAL_RCC_GPIOE_CLK_ENABLE() do { } while(0)
+
+/* cycle counter, derived from simulated time */
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+} DWT_Type;
+
+DWT_Type *sim_dwt(void);
+#define DWT sim_dwt()
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t LOAD;
+  volatile uint32_t VAL;
+} SysTick_Type;
+
+extern SysTick_Type sim_systick;
+#define SysTick (&sim_systick)
+#define SysTick_CTRL_ENABLE_Msk 1U
+
+typedef enum {
+  DMA1_Stream0_IRQn = 11,
+  TIM1_UP_IRQn = 25,
+  OTG_FS_WKUP_IRQn = 76,
+  SPI4_IRQn = 84
+} IRQn_Type;
+
+#define NVIC_EnableIRQ(irq)       do { (void)(irq); } while(0)
+#define NVIC_DisableIRQ(irq)      do { (void)(irq); } while(0)
+#define NVIC_ClearPendingIRQ(irq) do { (void)(irq); } while(0)
+
+#define __DSB() do { } while(0)
+#define __DMB() do { } while(0)
+#define __ISB() do { } while(0)
+void sim_wfi(void);
+#define __WFI() sim_wfi()
+
+#define SCB_CleanDCache_by_Addr(addr, size)      do { (void)(addr); (void)(size); } while(0)
+#define SCB_InvalidateDCache_by_Addr(addr, size) do { (void)(addr); (void)(size); } while(0)
+
+extern uint32_t SystemCoreClock;
+void Delay_us(uint32_t us);
+void Delay_cycles(uint32_t cycles);
+
+/* SD card (BSP layer), backed by the card image */
+typedef struct {
+  uint32_t ErrorCode;
+} SD_HandleTypeDef;
+
+#define MSD_OK                ((uint8_t)0x00)
+#define MSD_ERROR             ((uint8_t)0x01)
+#define SD_TRANSFER_OK        ((uint8_t)0x00)
+#define SD_TRANSFER_BUSY      ((uint8_t)0x01)
+
+uint8_t BSP_SD_GetCardState(void);
+uint8_t BSP_SD_ReadBlocks_DMA(uint32_t *pData, uint32_t ReadAddr, uint32_t NumOfBlocks);
+uint8_t BSP_SD_WriteBlocks_DMA(uint32_t *pData, uint32_t WriteAddr, uint32_t NumOfBlocks);
+void BSP_SD_ReadCpltCallback(void);
+void BSP_SD_WriteCpltCallback(void);
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd);
+int HAL_SD_Abort(SD_HandleTypeDef *hsd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32_SIM_H */
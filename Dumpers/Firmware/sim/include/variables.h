@@ -0,0 +1,45 @@
+#ifndef __VARIABLES_H
+#define __VARIABLES_H
+
+/*
+ * Subset of User/Inc/variables.h used by the chip drivers. flag_button is
+ * routed through the simulator so button waits get answered.
+ */
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+extern SD_HandleTypeDef hsd1;
+
+// flags
+volatile uint32_t *sim_button(void);
+#define flag_button (*sim_button())
+
+// FatFs
+extern char SDPath[4];
+extern FATFS SDFatFs;
+
+// menu
+extern uint32_t cur_menu;
+extern uint32_t cur_chip;
+extern uint32_t cur_mode;
+
+// timer
+extern uint32_t ticks;
+
+// dump/flash sector buffer
+extern uint16_t buffer [BUFFER_SIZE];
+
+// chip names
+extern const char *CHIP_NAMES[];
+extern const char *DUMP_FILENAMES[];
+
+// address scramble lookup table
+extern uint16_t addr_lookup[512];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VARIABLES_H */
@@ -0,0 +1,122 @@
+#ifndef __SIM_H
+#define __SIM_H
+
+#include <stdint.h>
+
+/* time, ns */
+#define SIM_US        1000ULL
+#define SIM_MS        1000000ULL
+#define SIM_S         1000000000ULL
+
+/* latencies, ns, adjustable with -t name=value (see sim_timing.c) */
+typedef struct {
+  uint64_t gpio;          /* one GPIO register access */
+  uint64_t powercycle;    /* manual power cycle after a chip lock-up */
+  struct {
+    uint64_t acc, ce, oe, wp;
+    uint64_t erase, program, blank;
+    double lockup;        /* probability per erase/program operation */
+  } mt28;
+  struct {
+    uint64_t acc, pacc, ce, oe, wp;
+    uint64_t erase, program, buffer;
+  } s29;
+  struct {
+    uint64_t block, cmd, prog;
+  } sd;
+} sim_timing_t;
+
+extern sim_timing_t sim_timing;
+int sim_timing_set(const char *arg);
+void sim_timing_list(void);
+
+/* deterministic random numbers for lock-ups and test data */
+void sim_srand(uint64_t seed);
+uint32_t sim_rand(void);
+double sim_frand(void);
+
+extern uint64_t sim_ns;
+extern uint64_t sim_gpio_accesses;
+void sim_advance(uint64_t ns);
+void sim_idle_until(uint64_t t);
+void sim_gpio_reset(void);
+
+/* simulated time is accounted to the phase the firmware is in, as seen from
+   the last command it sent to the chips; waiting for the card counts as SD */
+enum {
+  SIM_PH_OTHER,
+  SIM_PH_READ,
+  SIM_PH_ERASE,
+  SIM_PH_BLANK,
+  SIM_PH_PROGRAM,
+  SIM_PH_SD,
+  SIM_PHASES
+};
+
+extern const char *sim_phase_names[SIM_PHASES];
+extern uint64_t sim_phase_ns[SIM_PHASES];
+extern int sim_phase;
+
+/* pin levels seen by the adapter after a GPIO access */
+typedef struct {
+  uint32_t addr;        /* address lines (A0-A26 C/V, A0-A25 P) */
+  uint16_t data;        /* data lines as driven by the MCU */
+  uint8_t data_out;     /* MCU drives the data lines */
+  uint16_t ctrl;        /* GPIOD pin levels, undriven pins read high */
+} sim_bus_t;
+
+typedef struct {
+  const char *name;
+  void (*init)(void);
+  /* called after every GPIO access */
+  void (*update)(const sim_bus_t *bus);
+  /* data driven by the chips, returns mask of driven bits */
+  uint16_t (*read)(uint16_t *data);
+  void (*report)(void);
+  /* power cycle, clears lock-ups */
+  void (*power)(void);
+} sim_adapter_t;
+
+extern const sim_adapter_t sim_adapter_cv;
+extern const sim_adapter_t sim_adapter_p;
+extern const sim_adapter_t *sim_adapter;
+
+/* bus protocol violations (WE# pulse too short, bus contention, ...) */
+extern uint32_t sim_violations;
+void sim_violation(const char *fmt, ...);
+
+/* button answer for waitYesNo(): FLAG_BTN_BRD = no, FLAG_BTN_BRD_LONG = yes */
+extern uint32_t sim_answer;
+extern int sim_verbose;
+
+/* SD card image */
+int sim_sd_open(const char *path, uint32_t size_mb);
+void sim_sd_close(void);
+void sim_sd_events(void);
+/* completion time of the SD transfer in flight, 0 = none */
+extern uint64_t sim_sd_pending;
+uint64_t sim_sd_next_event(void);
+
+/* image name returned by choose_image() */
+extern const char *sim_file;
+
+/* benchmark driver, power cycle and resume from saved progress */
+int sim_bench(const char *chips);
+void sim_power_cycle(void);
+int sim_resume(void);
+
+/* shared sparse flash array, 0xffff = erased */
+typedef struct {
+  uint32_t words;       /* size in 16 bit words */
+  uint32_t block_words; /* erase block size */
+  uint16_t **blocks;
+} sim_array_t;
+
+void sim_array_init(sim_array_t *a, uint32_t words, uint32_t block_words);
+void sim_array_free(sim_array_t *a);
+uint16_t sim_array_get(const sim_array_t *a, uint32_t addr);
+void sim_array_program(sim_array_t *a, uint32_t addr, uint16_t data);
+void sim_array_erase(sim_array_t *a, uint32_t addr);
+int sim_array_blank(const sim_array_t *a, uint32_t addr);
+
+#endif /* __SIM_H */
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+/*
+ * Sparse flash array. Blocks are allocated on first program, an erased
+ * block is freed again.
+ */
+
+void sim_array_init(sim_array_t *a, uint32_t words, uint32_t block_words) {
+  a->words = words;
+  a->block_words = block_words;
+  a->blocks = calloc(words / block_words, sizeof(uint16_t *));
+}
+
+uint16_t sim_array_get(const sim_array_t *a, uint32_t addr) {
+  const uint16_t *b;
+
+  addr %= a->words;
+  b = a->blocks[addr / a->block_words];
+  return b ? b[addr % a->block_words] : 0xffff;
+}
+
+/* program can only clear bits */
+void sim_array_program(sim_array_t *a, uint32_t addr, uint16_t data) {
+  uint16_t **b;
+
+  addr %= a->words;
+  b = &a->blocks[addr / a->block_words];
+  if(!*b) {
+    if(data == 0xffff) return;
+    *b = malloc(a->block_words * sizeof(uint16_t));
+    memset(*b, 0xff, a->block_words * sizeof(uint16_t));
+  }
+  (*b)[addr % a->block_words] &= data;
+}
+
+void sim_array_erase(sim_array_t *a, uint32_t addr) {
+  uint16_t **b;
+
+  addr %= a->words;
+  b = &a->blocks[addr / a->block_words];
+  free(*b);
+  *b = NULL;
+}
+
+int sim_array_blank(const sim_array_t *a, uint32_t addr) {
+  const uint16_t *b;
+
+  addr %= a->words;
+  b = a->blocks[addr / a->block_words];
+  if(!b) return 1;
+  for(uint32_t i = 0; i < a->block_words; i++) {
+    if(b[i] != 0xffff) return 0;
+  }
+  return 1;
+}
+
+void sim_array_free(sim_array_t *a) {
+  if(!a->blocks) return;
+  for(uint32_t i = 0; i < a->words / a->block_words; i++) {
+    free(a->blocks[i]);
+  }
+  free(a->blocks);
+  a->blocks = NULL;
+}
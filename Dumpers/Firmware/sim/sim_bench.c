@@ -0,0 +1,261 @@
+#include <time.h>
+#include "main.h"
+#include "sim.h"
+
+/*
+ * Throughput benchmark
+ * ====================
+ *
+ * Replays the jobs a cartridge goes through on fresh chips and reports the
+ * simulated wall-clock time of each, split by what the firmware was doing:
+ *
+ *   program     blank chip, CV_Program_Internal / P_Program_Internal
+ *   verify      CV_Verify / P_Verify
+ *   dump        CV_Dump / P_Dump, compared against the image
+ *   reprogram   half of the data sectors changed
+ *
+ * The image is random data with the last quarter of the sectors left at
+ * 0xff, like the unused end of a ROM. The same seed (-r) gives the same
+ * data and the same lock-ups.
+ *
+ * A fatal error saves the progress like on the real dumper; the benchmark
+ * then cycles the power and resumes from prog.state as main() does, which
+ * is what exercises mt28.lockup.
+ */
+
+#define BENCH_MAX_POWERCYCLES 16
+
+/* full sizes from defines.h, in the same units as END_ADDRESS_x */
+#define FULL_ADDRESS_CV   (0x40000000 / 4)
+#define FULL_ADDRESS_P    (0x8000000 / 2)
+
+#define SECTOR_WORDS      0x20000
+
+static uint32_t powercycles;
+
+/* turn everything off and on again; flash contents survive */
+void sim_power_cycle(void) {
+  sim_phase = SIM_PH_OTHER;
+  sim_idle_until(sim_ns + sim_timing.powercycle);
+  sim_gpio_reset();
+  CV_GPIO_Init();
+  sim_adapter_cv.power();
+  sim_adapter_p.power();
+  powercycles++;
+}
+
+/* what main() does when it finds saved progress and the answer is yes */
+int sim_resume(void) {
+  uint32_t done, sectors;
+  chip_t chip;
+  char name[JRN_NAME_LEN];
+
+  if(JRN_Load(name, &chip, &done, &sectors) != FR_OK) return 0;
+  if(chip == CHIP_P) {
+    sim_adapter = &sim_adapter_p;
+    cur_chip = CHIP_P;
+    P_Program_Internal(name, 1);
+  } else {
+    sim_adapter = &sim_adapter_cv;
+    cur_chip = chip;
+    CV_Program_Internal(name, 1, chip);
+  }
+  return 1;
+}
+
+static int write_image(const char *name, const uint8_t *data, uint32_t size) {
+  FIL file;
+  FRESULT res;
+  UINT bw;
+
+  res = f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE);
+  if(res == FR_OK) {
+    res = f_write(&file, data, size, &bw);
+    if(res == FR_OK && bw != size) res = FR_DENIED;
+    if(f_close(&file) != FR_OK && res == FR_OK) res = FR_DISK_ERR;
+  }
+  if(res != FR_OK) {
+    fprintf(stderr, "bench: %s: %s\n", name, get_fresult_name(res));
+  }
+  return res != FR_OK;
+}
+
+/* returns the number of mismatching bytes */
+static uint32_t compare_dump(const char *name, const uint8_t *data, uint32_t size) {
+  static uint8_t chunk[0x10000];
+  uint32_t diff = 0, pos = 0;
+  FIL file;
+  UINT br;
+
+  if(f_open(&file, name, FA_READ) != FR_OK) return size;
+  while(pos < size && f_read(&file, chunk, sizeof(chunk), &br) == FR_OK && br) {
+    for(UINT i = 0; i < br && pos < size; i++, pos++) {
+      diff += chunk[i] != data[pos];
+    }
+  }
+  f_close(&file);
+  return diff + (size - pos);
+}
+
+static void fill_random(uint8_t *p, uint32_t size) {
+  for(uint32_t i = 0; i < size; i += 4) {
+    uint32_t r = sim_rand();
+    memcpy(p + i, &r, size - i < 4 ? size - i : 4);
+  }
+}
+
+typedef struct {
+  const char *job;
+  uint64_t ns;
+  uint64_t phase[SIM_PHASES];
+  double host;
+  uint32_t powercycles;
+} bench_result_t;
+
+static void bench_print(char chip, const bench_result_t *r, int n, uint32_t size, double scale) {
+  printf("\n%c: %u bytes, full chip = %.0fx\n", chip, size, scale);
+  printf("  %-10s %9s", "job", "total s");
+  for(int p = SIM_PH_READ; p < SIM_PHASES; p++) {
+    printf(" %11s", sim_phase_names[p]);
+  }
+  printf(" %9s %8s %11s %7s %8s\n", "other", "MB/s", "full chip s", "power", "host s");
+  for(int i = 0; i < n; i++) {
+    printf("  %-10s %9.3f", r[i].job, r[i].ns / 1e9);
+    for(int p = SIM_PH_READ; p < SIM_PHASES; p++) {
+      printf(" %11.3f", r[i].phase[p] / 1e9);
+    }
+    printf(" %9.3f %8.2f %11.1f %7u %8.2f\n", r[i].phase[SIM_PH_OTHER] / 1e9,
+           size / (r[i].ns / 1e9) / 1e6, r[i].ns / 1e9 * scale, r[i].powercycles, r[i].host);
+  }
+}
+
+static int bench_chip(char chip) {
+  const char *image = chip == 'p' ? "bench_p.bin" : chip == 'c' ? "bench_c.bin" : "bench_v.bin";
+  chip_t type = chip == 'p' ? CHIP_P : chip == 'c' ? CHIP_C : CHIP_V;
+  uint32_t word = chip == 'p' ? 2 : 4;
+  uint32_t words = chip == 'p' ? END_ADDRESS_P : END_ADDRESS_C;
+  uint32_t size = words * word;
+  uint32_t sector = SECTOR_WORDS * word;
+  uint32_t sectors = (size + sector - 1) / sector;
+  uint32_t used = sectors - sectors / 4;
+  static const char *jobs[] = { "program", "verify", "dump", "reprogram" };
+  bench_result_t res[4];
+  uint8_t *data;
+  int done = 0, err = 0;
+
+  data = malloc(size);
+  if(!data) return 1;
+  fill_random(data, size);
+  if(used * sector < size) {
+    memset(data + used * sector, 0xff, size - used * sector);
+  }
+  if(write_image(image, data, size)) {
+    free(data);
+    return 1;
+  }
+
+  sim_adapter = chip == 'p' ? &sim_adapter_p : &sim_adapter_cv;
+  sim_adapter->init();
+  cur_chip = type;
+  sim_file = image;
+
+  for(int j = 0; j < 4 && !err; j++) {
+    bench_result_t *r = &res[j];
+    uint64_t t0;
+    uint32_t v0 = sim_violations;
+    uint32_t pc0 = powercycles;
+    clock_t c0;
+    int resumes = 0;
+
+    if(j == 3) {
+      /* reprogram: every other used sector gets new contents */
+      for(uint32_t s = 0; s < used; s += 2) {
+        uint32_t len = (s + 1) * sector > size ? size - s * sector : sector;
+        fill_random(data + s * sector, len);
+      }
+      if(write_image(image, data, size)) {
+        err = 1;
+        break;
+      }
+    }
+
+    r->job = jobs[j];
+    t0 = sim_ns;
+    c0 = clock();
+    memcpy(r->phase, sim_phase_ns, sizeof(r->phase));
+    sim_phase = SIM_PH_OTHER;
+    switch(j) {
+      case 0:
+      case 3:
+        if(chip == 'p') {
+          P_Program_Internal(image, 0);
+        } else {
+          CV_Program_Internal(image, 0, type);
+        }
+        while(resumes < BENCH_MAX_POWERCYCLES && f_stat(PROG_SAVE_FILE, NULL) == FR_OK) {
+          sim_power_cycle();
+          sim_resume();
+          resumes++;
+        }
+        break;
+      case 1:
+        if(chip == 'p') {
+          P_Verify();
+        } else {
+          chip == 'c' ? C_Verify() : V_Verify();
+        }
+        break;
+      case 2:
+        if(chip == 'p') {
+          P_Dump();
+        } else {
+          chip == 'c' ? C_Dump() : V_Dump();
+        }
+        break;
+    }
+    sim_phase = SIM_PH_OTHER;
+    r->ns = sim_ns - t0;
+    for(int p = 0; p < SIM_PHASES; p++) {
+      r->phase[p] = sim_phase_ns[p] - r->phase[p];
+    }
+    r->host = (double)(clock() - c0) / CLOCKS_PER_SEC;
+    r->powercycles = powercycles - pc0;
+
+    if(sim_violations != v0) {
+      printf("bench %c %s: %u bus violations\n", chip, r->job, sim_violations - v0);
+      err = 1;
+    }
+    if(j == 2) {
+      uint32_t diff = compare_dump(DUMP_FILENAMES[type], data, size);
+      if(diff) {
+        printf("bench %c: dump differs from the image in %u bytes\n", chip, diff);
+        err = 1;
+      }
+    }
+    if(resumes == BENCH_MAX_POWERCYCLES) {
+      printf("bench %c %s: gave up after %d power cycles\n", chip, r->job, resumes);
+      err = 1;
+    }
+    done++;
+  }
+  bench_print(chip, res, done, size, (double)(chip == 'p' ? FULL_ADDRESS_P : FULL_ADDRESS_CV) / words);
+  sim_adapter->report();
+  f_unlink(image);
+  f_unlink(DUMP_FILENAMES[type]);
+  free(data);
+  return err;
+}
+
+/* chips: any of "cvp" */
+int sim_bench(const char *chips) {
+  int err = 0;
+
+  for(const char *c = chips; *c && !err; c++) {
+    if(*c != 'c' && *c != 'v' && *c != 'p') {
+      fprintf(stderr, "bench: chip %c not supported\n", *c);
+      return 1;
+    }
+    err = bench_chip(*c);
+  }
+  return err;
+}
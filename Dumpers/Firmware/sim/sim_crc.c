@@ -0,0 +1,42 @@
+#include "main.h"
+
+/*
+ * Software CRC32 in place of the CRC unit, same polynomial and bit order
+ * (zlib compatible).
+ */
+
+static uint32_t crc_table[256];
+static uint32_t crc_state;
+
+void CRC32_Init(void) {
+  for(uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for(int k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+    }
+    crc_table[i] = c;
+  }
+}
+
+void CRC32_Start(void) {
+  if(!crc_table[1]) CRC32_Init();
+  crc_state = 0xffffffff;
+}
+
+void CRC32_Update(const void *data, uint32_t length) {
+  const uint8_t *p = data;
+
+  for(uint32_t i = 0; i < length; i++) {
+    crc_state = crc_table[(crc_state ^ p[i]) & 0xff] ^ (crc_state >> 8);
+  }
+}
+
+uint32_t CRC32_Value(void) {
+  return ~crc_state;
+}
+
+uint32_t CRC32_Buffer(const void *data, uint32_t length) {
+  CRC32_Start();
+  CRC32_Update(data, length);
+  return CRC32_Value();
+}
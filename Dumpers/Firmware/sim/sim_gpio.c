@@ -0,0 +1,184 @@
+#include "main.h"
+#include "sim.h"
+
+/*
+ * GPIO and time
+ * =============
+ *
+ * The drivers access the ports through GPIOx, which is sim_gpio(x) here.
+ * Each call applies the BSRR write of the previous access, lets the adapter
+ * see the new pin levels, recomputes IDR of the data ports and advances
+ * simulated time by one register access. Reads therefore see chip data as
+ * of the time of the access, including output delays of the flash models.
+ */
+
+static GPIO_TypeDef ports[5];
+static uint16_t data_bus;           /* last level of the data lines */
+
+uint64_t sim_ns;
+uint64_t sim_gpio_accesses;
+const char *sim_phase_names[SIM_PHASES] = { "other", "read", "erase", "blank check", "program", "SD wait" };
+uint64_t sim_phase_ns[SIM_PHASES];
+int sim_phase;
+uint32_t sim_violations;
+uint32_t SystemCoreClock = 480000000;
+SysTick_Type sim_systick;
+
+static DWT_Type dwt;
+
+void sim_gpio_reset(void) {
+  for(int i = 0; i < 5; i++) {
+    memset(&ports[i], 0, sizeof(GPIO_TypeDef));
+    ports[i].MODER = 0xffffffff; // analog
+  }
+}
+
+/* gather the even bits of a 2 bit per pin field */
+static inline uint32_t sim_even_bits(uint32_t x) {
+  x &= 0x55555555;
+  x = (x | (x >> 1)) & 0x33333333;
+  x = (x | (x >> 2)) & 0x0f0f0f0f;
+  x = (x | (x >> 4)) & 0x00ff00ff;
+  x = (x | (x >> 8)) & 0x0000ffff;
+  return x;
+}
+
+/* pins configured as output (MODER = 01) */
+static inline uint32_t sim_out_mask(const GPIO_TypeDef *p) {
+  return sim_even_bits(p->MODER & ~(p->MODER >> 1));
+}
+
+static void sim_flush(void) {
+  static uint16_t contention;
+  static sim_bus_t last;
+  static const sim_adapter_t *last_adapter;
+  sim_bus_t bus;
+  uint16_t chip_data = 0, chip_mask = 0;
+  uint16_t out, out_mask, pu, pd;
+
+  for(int i = 0; i < 5; i++) {
+    uint32_t bsrr = ports[i].BSRR;
+    if(bsrr) {
+      ports[i].ODR = (ports[i].ODR & ~(bsrr >> 16)) | (bsrr & 0xffff);
+      ports[i].BSRR = 0;
+    }
+  }
+
+  /* data lines D0-D7 = PA0-7, D8-D15 = PC0-7 */
+  out_mask = (sim_out_mask(&ports[0]) & 0xff) | ((sim_out_mask(&ports[2]) & 0xff) << 8);
+  out = ((ports[0].ODR & 0xff) | ((ports[2].ODR & 0xff) << 8)) & out_mask;
+  pu = (sim_even_bits(ports[0].PUPDR & ~(ports[0].PUPDR >> 1)) & 0xff) |
+       ((sim_even_bits(ports[2].PUPDR & ~(ports[2].PUPDR >> 1)) & 0xff) << 8);
+  pd = (sim_even_bits((ports[0].PUPDR >> 1) & ~ports[0].PUPDR) & 0xff) |
+       ((sim_even_bits((ports[2].PUPDR >> 1) & ~ports[2].PUPDR) & 0xff) << 8);
+
+  /* undriven control and address pins read high (pull-ups on the adapter) */
+  bus.addr = (ports[1].ODR & 0xffff) | ((ports[4].ODR & 0x3ff) << 16) | (((ports[4].ODR >> 15) & 1) << 26);
+  bus.data = out;
+  bus.data_out = out_mask != 0;
+  bus.ctrl = (ports[3].ODR | ~sim_out_mask(&ports[3])) & 0xffff;
+  if(sim_adapter) {
+    if(bus.addr != last.addr || bus.data != last.data || bus.data_out != last.data_out ||
+       bus.ctrl != last.ctrl || sim_adapter != last_adapter) {
+      sim_adapter->update(&bus);
+      last = bus;
+      last_adapter = sim_adapter;
+    }
+    chip_mask = sim_adapter->read(&chip_data);
+  }
+  if((chip_mask & out_mask) && !contention) {
+    sim_violation("bus contention, chip and MCU drive %04x", chip_mask & out_mask);
+  }
+  contention = chip_mask & out_mask;
+
+  /* undriven lines follow the pull resistors, or keep their level */
+  data_bus = (data_bus & ~chip_mask) | (chip_data & chip_mask);
+  data_bus = (data_bus & ~out_mask) | out;
+  data_bus |= pu & ~(out_mask | chip_mask);
+  data_bus &= ~(pd & ~(out_mask | chip_mask));
+
+  for(int i = 0; i < 5; i++) {
+    ports[i].IDR = ports[i].ODR;
+  }
+  ports[0].IDR = (ports[0].IDR & 0xff00) | (data_bus & 0xff);
+  ports[2].IDR = (ports[2].IDR & 0xff00) | (data_bus >> 8);
+}
+
+GPIO_TypeDef *sim_gpio(int port) {
+  sim_flush();
+  sim_advance(sim_timing.gpio);
+  sim_gpio_accesses++;
+  return &ports[port];
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init) {
+  for(int i = 0; i < 16; i++) {
+    if(init->Pin & (1 << i)) {
+      port->MODER = (port->MODER & ~(3 << (2 * i))) | (init->Mode << (2 * i));
+      port->PUPDR = (port->PUPDR & ~(3 << (2 * i))) | (init->Pull << (2 * i));
+    }
+  }
+}
+
+/* advance simulated time, delivering SD card events and LCD refreshes
+   that are due */
+void sim_advance(uint64_t ns) {
+  static uint64_t next_tick = 10 * SIM_MS;
+
+  sim_ns += ns;
+  sim_phase_ns[sim_phase] += ns;
+  if(sim_ns >= next_tick) {
+    ticks = sim_ns / (10 * SIM_MS);
+    next_tick = (ticks + 1) * 10 * SIM_MS;
+    STATUS_Drain(1);
+  }
+  if(sim_sd_pending && sim_ns >= sim_sd_pending) {
+    sim_sd_events();
+  }
+}
+
+/* let time pass without bus activity */
+void sim_idle_until(uint64_t t) {
+  if(t > sim_ns) {
+    sim_advance(t - sim_ns);
+  }
+}
+
+DWT_Type *sim_dwt(void) {
+  dwt.CYCCNT = (uint32_t)(sim_ns * (SystemCoreClock / 1000000) / 1000);
+  return &dwt;
+}
+
+void Delay_cycles(uint32_t cycles) {
+  sim_flush();
+  sim_advance((uint64_t)cycles * 1000 / (SystemCoreClock / 1000000));
+}
+
+void Delay_us(uint32_t us) {
+  sim_flush();
+  sim_advance(us * SIM_US);
+}
+
+/* sleep until the next SD event or timer tick */
+void sim_wfi(void) {
+  uint64_t next = (ticks + 1) * 10 * SIM_MS;
+  uint64_t sd = sim_sd_next_event();
+  int phase = sim_phase;
+
+  /* sleeping with a transfer in flight is waiting for the card */
+  if(sd) sim_phase = SIM_PH_SD;
+  sim_idle_until(sd && sd < next ? sd : next);
+  sim_phase = phase;
+}
+
+void sim_violation(const char *fmt, ...) {
+  va_list ap;
+
+  if(sim_violations++ < 16) {
+    fprintf(stderr, "[%12.6f] ", sim_ns / 1e9);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+  }
+}
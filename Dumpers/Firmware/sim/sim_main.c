@@ -0,0 +1,241 @@
+#include <time.h>
+#include <getopt.h>
+#include "main.h"
+#include "sim.h"
+
+/*
+ * vtxsim - run the dumper's flash routines against simulated chips
+ *
+ * Commands are executed in order against one set of flash models, so a
+ * program/dump round trip can be checked in a single run:
+ *
+ *   vtxsim put crom.bin c.bin prog c c.bin dump c get crom.dump out.bin
+ */
+
+void CV_Init(void);
+
+const sim_adapter_t *sim_adapter;
+
+static BYTE mkfs_work[FF_MAX_SS * 4];
+/* format a new card image as exFAT instead of FAT32 */
+static int mkfs_exfat;
+static uint8_t copy_buf[0x10000];
+
+static void usage(void) {
+  fprintf(stderr,
+    "usage: vtxsim [-i image] [-s size_mb] [-x] [-y] [-v] [-t name=value] [-r seed] command [args] ...\n"
+    "  -i image   SD card image (default sd.img, created if missing)\n"
+    "  -s mb      size of a new card image (default 256)\n"
+    "  -x         format a new card image as exFAT (256kB clusters)\n"
+    "  -y         answer prompts with yes (long press)\n"
+    "  -v         show LCD status lines\n"
+    "  -t n=v     set a latency, e.g. mt28.erase=2s (-T lists them)\n"
+    "  -r seed    seed for lock-ups and benchmark data\n"
+    "commands (chip = c, v or p):\n"
+    "  put <host file> <card file>     copy a file onto the card\n"
+    "  get <card file> <host file>     copy a file from the card\n"
+    "  prog <chip> <card file>         program (card file:n = part n of a larger file)\n"
+    "  verify <chip> <card file>       verify\n"
+    "  dump <chip>                     dump to the card\n"
+    "  erase <chip>                    erase (c and v share the chips)\n"
+    "  blank                           C/V blank check\n"
+    "  power                           power cycle (clears chip lock-ups)\n"
+    "  resume                          continue from saved progress\n"
+    "  bench [chips]                   program/verify/dump benchmark (default cvp)\n");
+  exit(2);
+}
+
+static int cmd_put(const char *src, const char *dst) {
+  FILE *in = fopen(src, "rb");
+  FIL file;
+  FRESULT res;
+  size_t n;
+  UINT bw;
+
+  if(!in) {
+    perror(src);
+    return 1;
+  }
+  res = f_open(&file, dst, FA_CREATE_ALWAYS | FA_WRITE);
+  while(res == FR_OK && (n = fread(copy_buf, 1, sizeof(copy_buf), in)) > 0) {
+    res = f_write(&file, copy_buf, n, &bw);
+    if(res == FR_OK && bw != n) res = FR_DENIED;
+  }
+  fclose(in);
+  if(f_close(&file) != FR_OK || res != FR_OK) {
+    fprintf(stderr, "put %s: %s\n", dst, get_fresult_name(res));
+    return 1;
+  }
+  return 0;
+}
+
+static int cmd_get(const char *src, const char *dst) {
+  FILE *out;
+  FIL file;
+  FRESULT res;
+  UINT br;
+
+  res = f_open(&file, src, FA_READ);
+  if(res != FR_OK) {
+    fprintf(stderr, "get %s: %s\n", src, get_fresult_name(res));
+    return 1;
+  }
+  out = fopen(dst, "wb");
+  if(!out) {
+    perror(dst);
+    f_close(&file);
+    return 1;
+  }
+  while((res = f_read(&file, copy_buf, sizeof(copy_buf), &br)) == FR_OK && br) {
+    fwrite(copy_buf, 1, br, out);
+  }
+  fclose(out);
+  f_close(&file);
+  return res != FR_OK;
+}
+
+static int mount(void) {
+  MKFS_PARM exfat = { FM_EXFAT, 0, 0, 0, 0x40000 };
+  FRESULT res = f_mount(&SDFatFs, "", 1);
+
+  if(res == FR_NO_FILESYSTEM) {
+    res = f_mkfs("", mkfs_exfat ? &exfat : NULL, mkfs_work, sizeof(mkfs_work));
+    if(res == FR_OK) {
+      res = f_mount(&SDFatFs, "", 1);
+    }
+  }
+  if(res != FR_OK) {
+    fprintf(stderr, "mount: %s\n", get_fresult_name(res));
+    return 1;
+  }
+  return 0;
+}
+
+/* run a firmware entry point and report simulated time */
+static int run(const char *name, char chip, void (*cv)(void), void (*p)(void)) {
+  uint64_t t0 = sim_ns;
+  uint32_t v0 = sim_violations;
+  clock_t c0 = clock();
+
+  if(chip == 'p' && p) {
+    sim_adapter = &sim_adapter_p;
+    cur_chip = CHIP_P;
+    p();
+  } else if((chip == 'c' || chip == 'v') && cv) {
+    sim_adapter = &sim_adapter_cv;
+    cur_chip = chip == 'c' ? CHIP_C : CHIP_V;
+    cv();
+  } else {
+    fprintf(stderr, "%s: chip %c not supported\n", name, chip);
+    return 1;
+  }
+  printf("== %s %c: %.3f s simulated, %.3f s host\n", name, chip,
+         (sim_ns - t0) / 1e9, (double)(clock() - c0) / CLOCKS_PER_SEC);
+  sim_adapter->report();
+  if(sim_violations != v0) {
+    printf("  %u bus violations\n", sim_violations - v0);
+    return 1;
+  }
+  return 0;
+}
+
+static void cv_erase(void) {
+  CV_Init();
+  CV_Erase();
+}
+
+static void cv_blank(void) {
+  CV_Init();
+  CV_BlankCheck();
+}
+
+static void resume(void) {
+  if(!sim_resume()) {
+    printf("no saved progress\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *image = "sd.img";
+  uint32_t size_mb = 256;
+  int err = 0;
+  int opt;
+
+  while((opt = getopt(argc, argv, "i:s:xyvt:Tr:h")) != -1) {
+    switch(opt) {
+      case 'i': image = optarg; break;
+      case 's': size_mb = strtoul(optarg, NULL, 0); break;
+      case 'x': mkfs_exfat = 1; break;
+      case 'y': sim_answer = FLAG_BTN_BRD_LONG; break;
+      case 'v': sim_verbose = 1; break;
+      case 't':
+        if(sim_timing_set(optarg)) {
+          fprintf(stderr, "bad timing parameter: %s\n", optarg);
+          return 2;
+        }
+        break;
+      case 'T': sim_timing_list(); return 0;
+      case 'r': sim_srand(strtoull(optarg, NULL, 0)); break;
+      default: usage();
+    }
+  }
+  if(optind >= argc) usage();
+
+  /* pins as set up by main() */
+  sim_gpio_reset();
+  CV_GPIO_Init();
+  sim_adapter_cv.init();
+  sim_adapter_p.init();
+  if(sim_sd_open(image, size_mb)) {
+    perror(image);
+    return 1;
+  }
+  if(mount()) return 1;
+
+  for(int i = optind; i < argc && !err; i++) {
+    const char *cmd = argv[i];
+    const char *arg1 = i + 1 < argc ? argv[i + 1] : NULL;
+    const char *arg2 = i + 2 < argc ? argv[i + 2] : NULL;
+
+    if(!strcmp(cmd, "put") && arg2) {
+      err = cmd_put(arg1, arg2);
+      i += 2;
+    } else if(!strcmp(cmd, "get") && arg2) {
+      err = cmd_get(arg1, arg2);
+      i += 2;
+    } else if(!strcmp(cmd, "prog") && arg2) {
+      sim_file = arg2;
+      err = run(cmd, arg1[0], arg1[0] == 'c' ? C_Program : V_Program, P_Program);
+      i += 2;
+    } else if(!strcmp(cmd, "verify") && arg2) {
+      sim_file = arg2;
+      err = run(cmd, arg1[0], arg1[0] == 'c' ? C_Verify : V_Verify, P_Verify);
+      i += 2;
+    } else if(!strcmp(cmd, "dump") && arg1) {
+      err = run(cmd, arg1[0], arg1[0] == 'c' ? C_Dump : V_Dump, P_Dump);
+      i++;
+    } else if(!strcmp(cmd, "erase") && arg1) {
+      err = run(cmd, arg1[0], cv_erase, P_Erase);
+      i++;
+    } else if(!strcmp(cmd, "blank")) {
+      err = run(cmd, 'c', cv_blank, NULL);
+    } else if(!strcmp(cmd, "power")) {
+      sim_power_cycle();
+    } else if(!strcmp(cmd, "resume")) {
+      err = run(cmd, 'c', resume, NULL);
+    } else if(!strcmp(cmd, "bench")) {
+      if(arg1 && strspn(arg1, "cvp") == strlen(arg1)) {
+        err = sim_bench(arg1);
+        i++;
+      } else {
+        err = sim_bench("cvp");
+      }
+    } else {
+      usage();
+    }
+  }
+
+  f_mount(NULL, "", 0);
+  sim_sd_close();
+  return err;
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include "sim.h"
+
+/*
+ * C/V adapter: 4x MT28GU01G packages (two dies each)
+ * ===================================================
+ *
+ * CE1#-CE4# = PD0, PD1, PD3, PD4, OE1#-OE4# = PD5-PD8, RST# = PD9,
+ * WE# = PD10, WP# = PD11. A0-A25 address a die, A26 selects the die.
+ *
+ * Each die has its own command state machine (Intel/Micron command set):
+ *
+ *   0x50        clear status register
+ *   0x70        read status register
+ *   0x90        read identifier (0x0089, 0x88b0, lock status)
+ *   0xff        read array
+ *   0x60 0xd0   unlock block, 0x60 0x01 lock block
+ *   0x20 0xd0   block erase
+ *   0xbc 0xd0   blank check
+ *   0xe9 n ... 0xd0   buffered program, n+1 words within one 512 word region
+ *
+ * Program and erase commands switch the die to status mode. Array contents
+ * change as soon as a command is accepted, but SR.7 stays clear until the
+ * operation time has passed. All blocks are locked after power-up and RST#.
+ *
+ * With mt28.lockup set, an erase or program occasionally hangs the die: it
+ * stays busy and ignores commands and RST# until the power is cycled.
+ */
+
+#define MT28_DIE_WORDS    0x4000000  /* 1 Gbit */
+#define MT28_BLOCK_WORDS  0x20000
+#define MT28_BLOCKS       (MT28_DIE_WORDS / MT28_BLOCK_WORDS)
+#define MT28_REGION       512
+
+/* status register */
+#define SR_READY          0x80
+#define SR_ERASE_ERR      0x20
+#define SR_PROG_ERR       0x10
+#define SR_LOCKED         0x02
+
+enum { ST_CMD, ST_LOCK, ST_ERASE, ST_BLANK, ST_BUF_COUNT, ST_BUF_DATA, ST_BUF_CONFIRM };
+enum { MODE_ARRAY, MODE_STATUS, MODE_ID };
+
+typedef struct {
+  sim_array_t array;
+  uint8_t locked[MT28_BLOCKS];
+  uint8_t state;
+  uint8_t mode;
+  uint8_t sr;
+  uint64_t busy_until;
+  uint8_t hung;
+  uint32_t buf_base;
+  uint32_t buf_count, buf_n;
+  uint16_t buf[MT28_REGION];
+  uint16_t buf_mask[MT28_REGION];
+  /* statistics */
+  uint32_t erases, programs, blank_checks, lockups;
+} mt28_die_t;
+
+typedef struct {
+  mt28_die_t die[2];
+  uint8_t ce, oe, we;
+  uint32_t addr;
+  uint16_t data;
+  uint64_t t_ce, t_oe, t_we;
+  uint16_t out;          /* last valid output */
+} mt28_t;
+
+static mt28_t chips[4];
+static uint8_t rst;
+static uint32_t bus_addr;
+static uint64_t t_addr;
+static uint16_t drive_prev;
+
+static void mt28_die_reset(mt28_die_t *d) {
+  if(d->hung) return;
+  d->state = ST_CMD;
+  d->mode = MODE_ARRAY;
+  d->sr = 0;
+  d->busy_until = 0;
+  for(int i = 0; i < MT28_BLOCKS; i++) {
+    d->locked[i] = 1;
+  }
+}
+
+static void mt28_busy(mt28_die_t *d, uint64_t t, int may_hang) {
+  d->busy_until = sim_ns + t;
+  d->mode = MODE_STATUS;
+  if(may_hang && sim_timing.mt28.lockup > 0 && sim_frand() < sim_timing.mt28.lockup) {
+    d->hung = 1;
+    d->busy_until = UINT64_MAX;
+    d->lockups++;
+  }
+}
+
+static void mt28_write(mt28_die_t *d, uint32_t addr, uint16_t data) {
+  uint32_t block = (addr % MT28_DIE_WORDS) / MT28_BLOCK_WORDS;
+  uint8_t cmd = data & 0xff;
+
+  if(d->hung) return;
+  if(sim_ns < d->busy_until) {
+    if(cmd == 0x70) {
+      d->mode = MODE_STATUS;
+    } else {
+      sim_violation("MT28: command %04x while busy", data);
+    }
+    return;
+  }
+
+  switch(d->state) {
+    case ST_CMD:
+      switch(cmd) {
+        case 0xff: d->mode = MODE_ARRAY; sim_phase = SIM_PH_READ; break;
+        case 0x70: d->mode = MODE_STATUS; break;
+        case 0x90: d->mode = MODE_ID; break;
+        case 0x50: d->sr = 0; break;
+        case 0x60: d->state = ST_LOCK; break;
+        case 0x20: d->state = ST_ERASE; sim_phase = SIM_PH_ERASE; break;
+        case 0xbc: d->state = ST_BLANK; sim_phase = SIM_PH_BLANK; break;
+        case 0xe9:
+          sim_phase = SIM_PH_PROGRAM;
+          d->state = ST_BUF_COUNT;
+          d->mode = MODE_STATUS;
+          d->buf_base = addr & ~(MT28_REGION - 1);
+          break;
+        default:
+          sim_violation("MT28: unknown command %04x at %08x", data, addr);
+          break;
+      }
+      break;
+
+    case ST_LOCK:
+      if(cmd == 0xd0) {
+        d->locked[block] = 0;
+      } else if(cmd == 0x01) {
+        d->locked[block] = 1;
+      } else {
+        d->sr |= SR_ERASE_ERR | SR_PROG_ERR;
+      }
+      d->mode = MODE_STATUS;
+      d->state = ST_CMD;
+      break;
+
+    case ST_ERASE:
+      if(cmd != 0xd0) {
+        d->sr |= SR_ERASE_ERR | SR_PROG_ERR;
+      } else if(d->locked[block]) {
+        d->sr |= SR_ERASE_ERR | SR_LOCKED;
+      } else {
+        sim_array_erase(&d->array, addr);
+        d->erases++;
+        mt28_busy(d, sim_timing.mt28.erase, 1);
+      }
+      d->mode = MODE_STATUS;
+      d->state = ST_CMD;
+      break;
+
+    case ST_BLANK:
+      if(cmd != 0xd0) {
+        d->sr |= SR_ERASE_ERR | SR_PROG_ERR;
+      } else {
+        if(!sim_array_blank(&d->array, addr)) {
+          d->sr |= SR_ERASE_ERR;
+        }
+        d->blank_checks++;
+        mt28_busy(d, sim_timing.mt28.blank, 0);
+      }
+      d->mode = MODE_STATUS;
+      d->state = ST_CMD;
+      break;
+
+    case ST_BUF_COUNT:
+      d->buf_count = data + 1;
+      d->buf_n = 0;
+      if(d->buf_count > MT28_REGION) {
+        d->sr |= SR_ERASE_ERR | SR_PROG_ERR;
+        d->state = ST_CMD;
+        break;
+      }
+      for(int i = 0; i < MT28_REGION; i++) {
+        d->buf_mask[i] = 0;
+      }
+      d->state = ST_BUF_DATA;
+      break;
+
+    case ST_BUF_DATA:
+      if((addr & ~(MT28_REGION - 1)) != d->buf_base) {
+        sim_violation("MT28: buffer write %08x outside region %08x", addr, d->buf_base);
+        d->sr |= SR_PROG_ERR;
+      }
+      d->buf[addr & (MT28_REGION - 1)] = data;
+      d->buf_mask[addr & (MT28_REGION - 1)] = 1;
+      if(++d->buf_n == d->buf_count) {
+        d->state = ST_BUF_CONFIRM;
+      }
+      break;
+
+    case ST_BUF_CONFIRM:
+      d->state = ST_CMD;
+      d->mode = MODE_STATUS;
+      if(cmd != 0xd0) {
+        d->sr |= SR_ERASE_ERR | SR_PROG_ERR;
+      } else if(d->locked[(d->buf_base % MT28_DIE_WORDS) / MT28_BLOCK_WORDS]) {
+        d->sr |= SR_PROG_ERR | SR_LOCKED;
+      } else {
+        for(int i = 0; i < MT28_REGION; i++) {
+          if(d->buf_mask[i]) {
+            sim_array_program(&d->array, d->buf_base + i, d->buf[i]);
+          }
+        }
+        d->programs++;
+        mt28_busy(d, sim_timing.mt28.program, 1);
+      }
+      break;
+  }
+}
+
+static uint16_t mt28_output(mt28_die_t *d, uint32_t addr) {
+  if(d->mode == MODE_STATUS || sim_ns < d->busy_until) {
+    return (sim_ns < d->busy_until ? 0 : SR_READY) | d->sr;
+  }
+  if(d->mode == MODE_ID) {
+    switch(addr & 0xff) {
+      case 0: return 0x0089;
+      case 1: return 0x88b0;
+      case 2: return d->locked[(addr % MT28_DIE_WORDS) / MT28_BLOCK_WORDS];
+      default: return 0;
+    }
+  }
+  return sim_array_get(&d->array, addr);
+}
+
+static void cv_init(void) {
+  for(int i = 0; i < 4; i++) {
+    for(int j = 0; j < 2; j++) {
+      mt28_die_t *d = &chips[i].die[j];
+      sim_array_free(&d->array);
+      sim_array_init(&d->array, MT28_DIE_WORDS, MT28_BLOCK_WORDS);
+      d->erases = d->programs = d->blank_checks = d->lockups = 0;
+      d->hung = 0;
+      mt28_die_reset(d);
+    }
+  }
+}
+
+/* array contents survive, everything else starts over */
+static void cv_power(void) {
+  for(int i = 0; i < 4; i++) {
+    for(int j = 0; j < 2; j++) {
+      chips[i].die[j].hung = 0;
+      mt28_die_reset(&chips[i].die[j]);
+    }
+  }
+}
+
+static void cv_update(const sim_bus_t *bus) {
+  static const int ce_pin[4] = { 0, 1, 3, 4 };
+  uint8_t nrst = !(bus->ctrl & (1 << 9));
+  uint8_t we = !(bus->ctrl & (1 << 10));
+
+  if(nrst && !rst) {
+    for(int i = 0; i < 4; i++) {
+      mt28_die_reset(&chips[i].die[0]);
+      mt28_die_reset(&chips[i].die[1]);
+    }
+  }
+  rst = nrst;
+  if(bus->addr != bus_addr) {
+    bus_addr = bus->addr;
+    t_addr = sim_ns;
+  }
+
+  for(int i = 0; i < 4; i++) {
+    mt28_t *c = &chips[i];
+    uint8_t ce = !rst && !(bus->ctrl & (1 << ce_pin[i]));
+    uint8_t oe = !rst && !(bus->ctrl & (1 << (5 + i)));
+    uint8_t cwe = ce && we;
+
+    if(ce && !c->ce) c->t_ce = sim_ns;
+    if(oe && !c->oe) c->t_oe = sim_ns;
+    if(cwe && !(c->ce && c->we)) c->t_we = sim_ns;
+    /* write is latched at the end of the CE#/WE# low period */
+    if(c->ce && c->we && !cwe) {
+      if(sim_ns - c->t_we < sim_timing.mt28.wp) {
+        sim_violation("MT28 CE%d: WE# pulse %lluns", i + 1, (unsigned long long)(sim_ns - c->t_we));
+      } else {
+        mt28_write(&c->die[(c->addr >> 26) & 1], c->addr & (MT28_DIE_WORDS - 1), c->data);
+      }
+    }
+    c->ce = ce;
+    c->oe = oe;
+    c->we = we;
+    if(cwe) {
+      c->addr = bus->addr;
+      c->data = bus->data;
+    }
+  }
+}
+
+/* chips output the previous data until the access time has passed */
+static uint16_t cv_read(uint16_t *data) {
+  uint16_t drive = 0;
+
+  for(int i = 0; i < 4; i++) {
+    mt28_t *c = &chips[i];
+    if(!c->ce || !c->oe || c->we) continue;
+    if(sim_ns - t_addr >= sim_timing.mt28.acc && sim_ns - c->t_ce >= sim_timing.mt28.ce &&
+       sim_ns - c->t_oe >= sim_timing.mt28.oe) {
+      c->out = mt28_output(&c->die[(bus_addr >> 26) & 1], bus_addr & (MT28_DIE_WORDS - 1));
+    }
+    *data = c->out;
+    drive |= 1 << i;
+  }
+  if((drive & (drive - 1)) && drive != drive_prev) {
+    sim_violation("MT28: chips %x drive the bus at the same time", drive);
+  }
+  drive_prev = drive;
+  return drive ? 0xffff : 0;
+}
+
+static void cv_report(void) {
+  for(int i = 0; i < 4; i++) {
+    for(int j = 0; j < 2; j++) {
+      mt28_die_t *d = &chips[i].die[j];
+      if(d->erases || d->programs || d->blank_checks) {
+        printf("  CE%d die %d: %u erases, %u buffer programs, %u blank checks",
+               i + 1, j, d->erases, d->programs, d->blank_checks);
+        printf(d->lockups ? ", %u lock-ups\n" : "\n", d->lockups);
+      }
+    }
+  }
+}
+
+const sim_adapter_t sim_adapter_cv = {
+  .name = "C/V (4x MT28GU01G)",
+  .init = cv_init,
+  .update = cv_update,
+  .read = cv_read,
+  .report = cv_report,
+  .power = cv_power
+};
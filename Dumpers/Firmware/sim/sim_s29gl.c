@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include "sim.h"
+
+/*
+ * P adapter: 2x S29GL512P in byte mode
+ * ====================================
+ *
+ * CE# = PD0, OE# = PD1, WE# = PD3. Both chips share address and control
+ * lines, the low chip drives D0-D7 and the high chip D8-D15. A0-A25 are the
+ * byte address (A-1 is the LSB in byte mode).
+ *
+ * Command set (AMD style, unlock = 0xaa at 0xaaa, 0x55 at 0x555):
+ *
+ *   unlock 0xa0, data           single byte program
+ *   unlock 0x25 at SA, n, n+1 bytes, 0x29 at SA   write buffer program
+ *   unlock 0x80 unlock 0x30 at SA   sector erase (0x10 = chip erase)
+ *   unlock 0x90                 autoselect
+ *   0xf0                        reset / return to read array
+ *
+ * While an operation is running, reads return the status byte: DQ7 is the
+ * complement of the last programmed bit (0 while erasing), DQ6 toggles with
+ * every read. Reads within the same 16 byte page after the first access use
+ * the page access time.
+ */
+
+#define S29_BYTES         0x4000000  /* 512 Mbit */
+#define S29_SECTOR        0x20000
+#define S29_PAGE          16
+#define S29_WBUF          64
+
+enum { ST_READ, ST_UNLOCK1, ST_UNLOCK2, ST_PROGRAM, ST_ERASE, ST_ERASE_UNLOCK1, ST_ERASE_UNLOCK2,
+       ST_BUF_COUNT, ST_BUF_DATA, ST_BUF_CONFIRM, ST_AUTOSELECT, ST_FAILED };
+
+typedef struct {
+  sim_array_t array;      /* one byte per entry */
+  uint8_t state;
+  uint8_t autoselect;
+  uint64_t busy_until;
+  uint8_t erasing;
+  uint8_t last;           /* last programmed byte, for DQ7 polling */
+  uint8_t toggle;
+  uint32_t buf_base, buf_count, buf_n;
+  uint8_t buf[S29_WBUF];
+  uint8_t buf_mask[S29_WBUF];
+  uint32_t erases, programs;
+} s29gl_t;
+
+static s29gl_t chips[2];
+static uint8_t ce, oe, we;
+static uint32_t bus_addr, w_addr;
+static uint16_t w_data, out;
+static uint64_t t_addr, t_page, t_ce, t_oe, t_we;
+
+static void s29_busy(s29gl_t *c, uint64_t t, int erasing) {
+  c->busy_until = sim_ns + t;
+  c->erasing = erasing;
+}
+
+/* program bytes; a 0 -> 1 transition fails with DQ5 set */
+static int s29_program(s29gl_t *c, uint32_t addr, uint8_t data) {
+  uint8_t old = sim_array_get(&c->array, addr);
+
+  sim_array_program(&c->array, addr, data | 0xff00);
+  c->last = data;
+  return (old & data) == data;
+}
+
+static void s29_write(s29gl_t *c, uint32_t addr, uint8_t data) {
+  uint32_t a = addr & 0xfff;
+  int ok;
+
+  if(sim_ns < c->busy_until) {
+    sim_violation("S29GL: write %02x at %08x while busy", data, addr);
+    return;
+  }
+  if(data == 0xf0 && c->state != ST_PROGRAM && c->state != ST_BUF_DATA) {
+    sim_phase = SIM_PH_READ;
+    c->state = ST_READ;
+    c->autoselect = 0;
+    return;
+  }
+
+  switch(c->state) {
+    case ST_READ:
+    case ST_AUTOSELECT:
+      c->state = (a == 0xaaa && data == 0xaa) ? ST_UNLOCK1 : c->state;
+      break;
+    case ST_UNLOCK1:
+      c->state = (a == 0x555 && data == 0x55) ? ST_UNLOCK2 : ST_READ;
+      break;
+    case ST_UNLOCK2:
+      c->state = ST_READ;
+      if(data == 0x25) {
+        sim_phase = SIM_PH_PROGRAM;
+        c->buf_base = addr & ~(S29_WBUF - 1);
+        c->state = ST_BUF_COUNT;
+      } else if(a != 0xaaa) {
+        sim_violation("S29GL: command %02x at %08x", data, addr);
+      } else if(data == 0xa0) {
+        sim_phase = SIM_PH_PROGRAM;
+        c->state = ST_PROGRAM;
+      } else if(data == 0x80) {
+        sim_phase = SIM_PH_ERASE;
+        c->state = ST_ERASE;
+      } else if(data == 0x90) {
+        c->autoselect = 1;
+        c->state = ST_AUTOSELECT;
+      } else {
+        sim_violation("S29GL: unknown command %02x", data);
+      }
+      break;
+    case ST_PROGRAM:
+      ok = s29_program(c, addr, data);
+      c->programs++;
+      s29_busy(c, sim_timing.s29.program, 0);
+      c->state = ok ? ST_READ : ST_FAILED;
+      break;
+    case ST_ERASE:
+      c->state = (a == 0xaaa && data == 0xaa) ? ST_ERASE_UNLOCK1 : ST_READ;
+      break;
+    case ST_ERASE_UNLOCK1:
+      c->state = (a == 0x555 && data == 0x55) ? ST_ERASE_UNLOCK2 : ST_READ;
+      break;
+    case ST_ERASE_UNLOCK2:
+      c->state = ST_READ;
+      if(data == 0x30) {
+        sim_array_erase(&c->array, addr);
+        c->erases++;
+        c->last = 0xff;
+        s29_busy(c, sim_timing.s29.erase, 1);
+      } else if(data == 0x10 && a == 0xaaa) {
+        for(uint32_t s = 0; s < S29_BYTES; s += S29_SECTOR) {
+          sim_array_erase(&c->array, s);
+        }
+        c->erases++;
+        c->last = 0xff;
+        s29_busy(c, sim_timing.s29.erase * (S29_BYTES / S29_SECTOR) / 4, 1);
+      } else {
+        sim_violation("S29GL: unknown erase command %02x", data);
+      }
+      break;
+    case ST_BUF_COUNT:
+      c->buf_count = data + 1;
+      c->buf_n = 0;
+      for(int i = 0; i < S29_WBUF; i++) {
+        c->buf_mask[i] = 0;
+      }
+      if((addr & ~(S29_WBUF - 1)) != c->buf_base || c->buf_count > S29_WBUF) {
+        sim_violation("S29GL: write buffer abort, count %u at %08x", c->buf_count, addr);
+        c->state = ST_FAILED;
+        break;
+      }
+      c->state = ST_BUF_DATA;
+      break;
+    case ST_BUF_DATA:
+      if((addr & ~(S29_WBUF - 1)) != c->buf_base) {
+        sim_violation("S29GL: write buffer abort, %08x outside %08x", addr, c->buf_base);
+        c->state = ST_FAILED;
+        break;
+      }
+      c->buf[addr & (S29_WBUF - 1)] = data;
+      c->buf_mask[addr & (S29_WBUF - 1)] = 1;
+      if(++c->buf_n == c->buf_count) {
+        c->state = ST_BUF_CONFIRM;
+      }
+      break;
+    case ST_BUF_CONFIRM:
+      if(data != 0x29 || (addr & ~(S29_WBUF - 1)) != c->buf_base) {
+        sim_violation("S29GL: write buffer abort, confirm %02x at %08x", data, addr);
+        c->state = ST_FAILED;
+        break;
+      }
+      ok = 1;
+      for(int i = 0; i < S29_WBUF; i++) {
+        if(c->buf_mask[i]) {
+          ok &= s29_program(c, c->buf_base + i, c->buf[i]);
+        }
+      }
+      c->programs++;
+      s29_busy(c, sim_timing.s29.buffer, 0);
+      c->state = ok ? ST_READ : ST_FAILED;
+      break;
+    case ST_FAILED:
+      /* only reset (0xf0) leaves this state */
+      break;
+  }
+}
+
+static uint8_t s29_output(s29gl_t *c, uint32_t addr) {
+  if(sim_ns < c->busy_until || c->state == ST_FAILED) {
+    uint8_t sr = (~c->last & 0x80) | (c->toggle ? 0x40 : 0);
+    if(c->erasing) sr = (c->toggle ? 0x44 : 0) | 0x08;
+    if(c->state == ST_FAILED && sim_ns >= c->busy_until) sr |= 0x20;
+    return sr;
+  }
+  if(c->autoselect) {
+    switch(addr & 0xff) {
+      case 0x00: return 0x01;
+      case 0x02: return 0x7e;
+      case 0x1c: return 0x23;
+      case 0x1e: return 0x01;
+      default: return 0x00;
+    }
+  }
+  return sim_array_get(&c->array, addr);
+}
+
+static void p_init(void) {
+  for(int i = 0; i < 2; i++) {
+    sim_array_free(&chips[i].array);
+    sim_array_init(&chips[i].array, S29_BYTES, S29_SECTOR);
+    chips[i].erases = chips[i].programs = 0;
+    chips[i].state = ST_READ;
+    chips[i].autoselect = 0;
+    chips[i].busy_until = 0;
+  }
+}
+
+static void p_power(void) {
+  for(int i = 0; i < 2; i++) {
+    chips[i].state = ST_READ;
+    chips[i].autoselect = 0;
+    chips[i].busy_until = 0;
+  }
+}
+
+static void p_update(const sim_bus_t *bus) {
+  uint8_t nce = !(bus->ctrl & (1 << 0));
+  uint8_t noe = !(bus->ctrl & (1 << 1));
+  uint8_t nwe = !(bus->ctrl & (1 << 3));
+  uint32_t addr = bus->addr & (S29_BYTES - 1);
+
+  if(addr != bus_addr) {
+    if((addr ^ bus_addr) & ~(S29_PAGE - 1)) {
+      t_addr = sim_ns;
+    }
+    t_page = sim_ns;
+    bus_addr = addr;
+  }
+  if(nce && !ce) t_ce = sim_ns;
+  if(noe && !oe) {
+    t_oe = sim_ns;
+    if(nce) {
+      chips[0].toggle ^= 1;
+      chips[1].toggle ^= 1;
+    }
+  }
+  if(nce && nwe && !(ce && we)) t_we = sim_ns;
+  if(ce && we && !(nce && nwe)) {
+    if(sim_ns - t_we < sim_timing.s29.wp) {
+      sim_violation("S29GL: WE# pulse %lluns", (unsigned long long)(sim_ns - t_we));
+    } else {
+      s29_write(&chips[0], w_addr, w_data & 0xff);
+      s29_write(&chips[1], w_addr, w_data >> 8);
+    }
+  }
+  ce = nce;
+  oe = noe;
+  we = nwe;
+  if(ce && we) {
+    w_addr = addr;
+    w_data = bus->data;
+  }
+}
+
+static uint16_t p_read(uint16_t *data) {
+  uint64_t t_first;
+
+  if(!ce || !oe || we) return 0;
+  /* page hit: only A0-A3 changed since the page was opened */
+  t_first = t_ce > t_oe ? t_ce : t_oe;
+  t_first = t_first > t_addr ? t_first : t_addr;
+  if(sim_ns - t_addr >= sim_timing.s29.acc && sim_ns - t_ce >= sim_timing.s29.ce &&
+     sim_ns - t_oe >= sim_timing.s29.oe &&
+     (t_page <= t_first || sim_ns - t_page >= sim_timing.s29.pacc)) {
+    out = s29_output(&chips[0], bus_addr) | (s29_output(&chips[1], bus_addr) << 8);
+  }
+  *data = out;
+  return 0xffff;
+}
+
+static void p_report(void) {
+  for(int i = 0; i < 2; i++) {
+    if(chips[i].erases || chips[i].programs) {
+      printf("  %s chip: %u erases, %u programs\n", i ? "high" : "low", chips[i].erases, chips[i].programs);
+    }
+  }
+}
+
+const sim_adapter_t sim_adapter_p = {
+  .name = "P (2x S29GL512P)",
+  .init = p_init,
+  .update = p_update,
+  .read = p_read,
+  .report = p_report,
+  .power = p_power
+};
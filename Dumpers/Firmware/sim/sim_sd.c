@@ -0,0 +1,178 @@
+#include <unistd.h>
+#include "main.h"
+#include "diskio.h"
+#include "sim.h"
+
+/*
+ * SD card backed by an image file
+ * ===============================
+ *
+ * FatFs goes through the disk_* functions below, which access the image
+ * synchronously and charge the transfer time to simulated time.
+ *
+ * The DMA functions used by stream.c only queue a transfer. Data is moved
+ * when the transfer completes in simulated time, and the completion
+ * callback is called from sim_advance() as the SDMMC interrupt would be.
+ * A buffer that is read before STREAM_Sync() or modified while a write is in
+ * flight therefore shows up as wrong data.
+ */
+
+#define SD_BLOCK          512
+
+static FILE *img;
+static uint32_t img_blocks;
+
+static struct {
+  uint8_t pending;
+  uint8_t write;
+  uint8_t *buf;
+  uint32_t lba, count;
+  uint64_t done_at;
+} xfer;
+static uint64_t card_busy_until;
+uint64_t sim_sd_pending;
+
+static uint64_t sd_time(uint32_t count) {
+  return sim_timing.sd.cmd + (uint64_t)count * sim_timing.sd.block;
+}
+
+static int sd_io(int write, uint8_t *buf, uint32_t lba, uint32_t count) {
+  if(lba + count > img_blocks) return 1;
+  if(fseeko(img, (off_t)lba * SD_BLOCK, SEEK_SET)) return 1;
+  if(write) {
+    return fwrite(buf, SD_BLOCK, count, img) != count;
+  }
+  return fread(buf, SD_BLOCK, count, img) != count;
+}
+
+int sim_sd_open(const char *path, uint32_t size_mb) {
+  off_t size;
+
+  img = fopen(path, "r+b");
+  if(!img) {
+    img = fopen(path, "w+b");
+    if(!img) return 1;
+    if(ftruncate(fileno(img), (off_t)size_mb << 20)) return 1;
+  }
+  fseeko(img, 0, SEEK_END);
+  size = ftello(img);
+  img_blocks = size / SD_BLOCK;
+  return 0;
+}
+
+void sim_sd_close(void) {
+  if(img) {
+    fclose(img);
+    img = NULL;
+  }
+}
+
+/* complete the DMA transfer in flight once it is due */
+void sim_sd_events(void) {
+  if(!xfer.pending || sim_ns < xfer.done_at) return;
+  xfer.pending = 0;
+  sim_sd_pending = 0;
+  if(sd_io(xfer.write, xfer.buf, xfer.lba, xfer.count)) {
+    HAL_SD_ErrorCallback(&hsd1);
+    return;
+  }
+  if(xfer.write) {
+    card_busy_until = sim_ns + sim_timing.sd.prog;
+    BSP_SD_WriteCpltCallback();
+  } else {
+    BSP_SD_ReadCpltCallback();
+  }
+}
+
+uint64_t sim_sd_next_event(void) {
+  return xfer.pending ? xfer.done_at : 0;
+}
+
+static uint8_t sd_queue(int write, uint32_t *pData, uint32_t addr, uint32_t count) {
+  if(xfer.pending || sim_ns < card_busy_until) {
+    return MSD_ERROR;
+  }
+  xfer.pending = 1;
+  xfer.write = write;
+  xfer.buf = (uint8_t *)pData;
+  xfer.lba = addr;
+  xfer.count = count;
+  xfer.done_at = sim_ns + sd_time(count);
+  sim_sd_pending = xfer.done_at;
+  return MSD_OK;
+}
+
+uint8_t BSP_SD_ReadBlocks_DMA(uint32_t *pData, uint32_t ReadAddr, uint32_t NumOfBlocks) {
+  return sd_queue(0, pData, ReadAddr, NumOfBlocks);
+}
+
+uint8_t BSP_SD_WriteBlocks_DMA(uint32_t *pData, uint32_t WriteAddr, uint32_t NumOfBlocks) {
+  return sd_queue(1, pData, WriteAddr, NumOfBlocks);
+}
+
+uint8_t BSP_SD_GetCardState(void) {
+  int phase = sim_phase;
+
+  sim_phase = SIM_PH_SD;
+  sim_advance(SIM_US);
+  sim_phase = phase;
+  return (xfer.pending || sim_ns < card_busy_until) ? SD_TRANSFER_BUSY : SD_TRANSFER_OK;
+}
+
+int HAL_SD_Abort(SD_HandleTypeDef *hsd) {
+  xfer.pending = 0;
+  sim_sd_pending = 0;
+  return 0;
+}
+
+/* FatFs disk I/O */
+
+DSTATUS disk_initialize(BYTE pdrv) {
+  return img ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv) {
+  return img ? 0 : STA_NOINIT;
+}
+
+/* wait for the card and transfer, charged to the SD phase */
+static void sd_wait_transfer(UINT count) {
+  int phase = sim_phase;
+
+  while(xfer.pending || sim_ns < card_busy_until) {
+    sim_wfi();
+  }
+  sim_phase = SIM_PH_SD;
+  sim_advance(sd_time(count));
+  sim_phase = phase;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count) {
+  sd_wait_transfer(count);
+  return sd_io(0, buff, sector, count) ? RES_ERROR : RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count) {
+  sd_wait_transfer(count);
+  if(sd_io(1, (BYTE *)buff, sector, count)) return RES_ERROR;
+  card_busy_until = sim_ns + sim_timing.sd.prog;
+  return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff) {
+  switch(cmd) {
+    case CTRL_SYNC:
+      fflush(img);
+      return RES_OK;
+    case GET_SECTOR_COUNT:
+      *(LBA_t *)buff = img_blocks;
+      return RES_OK;
+    case GET_SECTOR_SIZE:
+      *(WORD *)buff = SD_BLOCK;
+      return RES_OK;
+    case GET_BLOCK_SIZE:
+      *(DWORD *)buff = 1;
+      return RES_OK;
+  }
+  return RES_PARERR;
+}
@@ -0,0 +1,146 @@
+#include "main.h"
+#include "menu.h"
+#include "sim.h"
+
+/*
+ * Firmware globals, LCD output and user input
+ * ===========================================
+ *
+ * LCD_printf() output goes to stdout, the status lines written with
+ * LCD_xyprintf() and the status records only in verbose mode. Records are
+ * drained on every timer tick and before direct output, like the LCD
+ * refresh does.
+ *
+ * There is nobody to press the button: when flag_button is polled several
+ * times without any bus activity in between, the firmware is waiting for
+ * input and a press (sim_answer) is injected.
+ */
+
+#define SIM_BUTTON_POLLS  8
+
+SD_HandleTypeDef hsd1;
+char SDPath[4];
+FATFS SDFatFs;
+
+uint32_t cur_menu = MENU_CSEL;
+uint32_t cur_chip = CHIP_P;
+uint32_t cur_mode = MODE_TEST;
+
+uint32_t ticks;
+
+uint16_t buffer [BUFFER_SIZE];
+uint16_t addr_lookup[512];
+
+const char *CHIP_NAMES[] = {
+  CHIP_NAME_P,
+  CHIP_NAME_S,
+  CHIP_NAME_M,
+  CHIP_NAME_C,
+  CHIP_NAME_V
+};
+
+const char *DUMP_FILENAMES[] = {
+  DUMP_FILENAME_P,
+  DUMP_FILENAME_S,
+  DUMP_FILENAME_M,
+  DUMP_FILENAME_C,
+  DUMP_FILENAME_V
+};
+
+uint32_t sim_answer = FLAG_BTN_BRD;
+int sim_verbose;
+const char *sim_file;
+
+static volatile uint32_t button;
+static uint64_t button_accesses;
+static int button_polls;
+
+volatile uint32_t *sim_button(void) {
+  if(sim_gpio_accesses != button_accesses) {
+    button_polls = 0;
+  } else if(++button_polls >= SIM_BUTTON_POLLS) {
+    button_polls = 0;
+    /* a long press that was not taken is followed by a short one */
+    button = (button & sim_answer) ? FLAG_BTN_BRD : button | sim_answer;
+  }
+  /* polling takes time, too */
+  sim_advance(sim_timing.gpio);
+  button_accesses = sim_gpio_accesses;
+  return &button;
+}
+
+static void lcd_out(const char *s) {
+  for(; *s; s++) {
+    putchar(*s == '\r' ? '\n' : *s);
+  }
+}
+
+int LCD_vprintf(int c, char *format, va_list ap) {
+  char buf[256];
+  int n;
+
+  STATUS_Drain(1);
+  n = vsnprintf(buf, sizeof(buf), format, ap);
+  lcd_out(buf);
+  return n;
+}
+
+int LCD_printf(int c, char *format, ...) {
+  va_list ap;
+  int n;
+
+  va_start(ap, format);
+  n = LCD_vprintf(c, format, ap);
+  va_end(ap);
+  return n;
+}
+
+int LCD_xyprintf(int x, int y, int c, char *format, ...) {
+  va_list ap;
+  int n = 0;
+
+  STATUS_Drain(1);
+  if(sim_verbose) {
+    va_start(ap, format);
+    n = LCD_vprintf(c, format, ap);
+    va_end(ap);
+  }
+  return n;
+}
+
+int LCD_Status(int y, int c, char *format, ...) {
+  char buf[64];
+  va_list ap;
+  int n = 0;
+
+  if(sim_verbose) {
+    va_start(ap, format);
+    n = vsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+    printf("%s\n", buf);
+  }
+  return n;
+}
+
+void LCD_Clear(void) {
+  STATUS_Drain(0);
+}
+
+/* the image to program or verify is given on the command line, a part of
+   a larger file as "name:part" */
+FRESULT choose_image(char *image, FSIZE_t job) {
+  FRESULT res;
+
+  STREAM_ImageName(sim_file, image);
+  res = f_stat(image, NULL);
+  if(res != FR_OK) {
+    fprintf(stderr, "%s: %s\n", image, get_fresult_name(res));
+  }
+  snprintf(image, STREAM_NAME_LEN, "%s", sim_file);
+  return res;
+}
+
+/* interactive test menus are not available */
+menu_entry *menu_select(menu_entry *ent) {
+  return NULL;
+}
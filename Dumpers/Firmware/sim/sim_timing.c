@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "sim.h"
+
+/*
+ * Latency model
+ * =============
+ *
+ * All latencies of the simulated hardware in one place. The defaults are
+ * typical datasheet values; -t name=value changes one of them, so a run can
+ * be repeated against slower or faster parts (e.g. -t mt28.erase=2s).
+ * Times take an ns/us/ms/s suffix, default is ns.
+ */
+
+sim_timing_t sim_timing = {
+  .gpio = 10,                   /* AHB4 access behind the AXI bridge */
+  .powercycle = 2 * SIM_S,
+  .mt28 = {
+    .acc = 96, .ce = 96, .oe = 20, .wp = 50,
+    .erase = 800 * SIM_MS,
+    .program = 900 * SIM_US,    /* 512 word buffer */
+    .blank = 3 * SIM_MS,
+    .lockup = 0
+  },
+  .s29 = {
+    .acc = 110, .pacc = 25, .ce = 110, .oe = 25, .wp = 35,
+    .erase = 500 * SIM_MS,
+    .program = 60 * SIM_US,
+    .buffer = 240 * SIM_US      /* 64 byte buffer */
+  },
+  .sd = {
+    .block = 23000,             /* 4 bit bus at 50 MHz, ~22 MB/s */
+    .cmd = 50 * SIM_US,
+    .prog = 250 * SIM_US        /* card busy after a write */
+  }
+};
+
+#define T(field, help) { #field, offsetof(sim_timing_t, field), help }
+
+static const struct {
+  const char *name;
+  size_t offset;
+  const char *help;
+} params[] = {
+  T(gpio, "GPIO register access"),
+  T(powercycle, "power cycle after a lock-up"),
+  T(mt28.acc, "MT28 address access time"),
+  T(mt28.ce, "MT28 CE# access time"),
+  T(mt28.oe, "MT28 OE# access time"),
+  T(mt28.wp, "MT28 minimum WE# pulse"),
+  T(mt28.erase, "MT28 block erase"),
+  T(mt28.program, "MT28 buffer program"),
+  T(mt28.blank, "MT28 blank check"),
+  T(s29.acc, "S29GL address access time"),
+  T(s29.pacc, "S29GL page access time"),
+  T(s29.ce, "S29GL CE# access time"),
+  T(s29.oe, "S29GL OE# access time"),
+  T(s29.wp, "S29GL minimum WE# pulse"),
+  T(s29.erase, "S29GL sector erase"),
+  T(s29.program, "S29GL byte program"),
+  T(s29.buffer, "S29GL write buffer program"),
+  T(sd.block, "SD transfer per 512 byte block"),
+  T(sd.cmd, "SD command overhead"),
+  T(sd.prog, "SD busy after a write"),
+};
+
+static uint64_t parse_time(const char *s, int *ok) {
+  char *end;
+  double v = strtod(s, &end);
+
+  *ok = end != s && v >= 0;
+  if(!strcmp(end, "s")) return v * SIM_S;
+  if(!strcmp(end, "ms")) return v * SIM_MS;
+  if(!strcmp(end, "us")) return v * SIM_US;
+  if(*end && strcmp(end, "ns")) *ok = 0;
+  return v;
+}
+
+/* name=value; returns nonzero on unknown names or bad values */
+int sim_timing_set(const char *arg) {
+  const char *eq = strchr(arg, '=');
+  int ok;
+
+  if(!eq) return 1;
+  if(!strncmp(arg, "mt28.lockup=", eq - arg + 1)) {
+    char *end;
+    sim_timing.mt28.lockup = strtod(eq + 1, &end);
+    return *end || sim_timing.mt28.lockup < 0 || sim_timing.mt28.lockup > 1;
+  }
+  for(size_t i = 0; i < sizeof(params) / sizeof(params[0]); i++) {
+    if(strlen(params[i].name) == (size_t)(eq - arg) && !strncmp(arg, params[i].name, eq - arg)) {
+      uint64_t t = parse_time(eq + 1, &ok);
+      if(!ok) return 1;
+      *(uint64_t *)((char *)&sim_timing + params[i].offset) = t;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void sim_timing_list(void) {
+  for(size_t i = 0; i < sizeof(params) / sizeof(params[0]); i++) {
+    printf("  %-14s %12llu ns  %s\n", params[i].name,
+           (unsigned long long)*(uint64_t *)((char *)&sim_timing + params[i].offset), params[i].help);
+  }
+  printf("  %-14s %12g     %s\n", "mt28.lockup", sim_timing.mt28.lockup,
+         "MT28 lock-up probability per erase/program");
+}
+
+/* xorshift64*, so runs with the same seed are repeatable */
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+void sim_srand(uint64_t seed) {
+  rng_state = seed ? seed : 0x9e3779b97f4a7c15ULL;
+}
+
+uint32_t sim_rand(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (rng_state * 0x2545f4914f6cdd1dULL) >> 32;
+}
+
+double sim_frand(void) {
+  return sim_rand() / 4294967296.0;
+}
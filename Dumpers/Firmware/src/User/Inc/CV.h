@@ -24,7 +24,7 @@ void V_Dump(void);
 
 void CV_ReadTest(void);
 
-void CV_Program_Internal(const char *filename, uint32_t address, chip_t chiptype);
+void CV_Program_Internal(const char *filename, int resume, chip_t chiptype);
 
 #ifdef __cplusplus
 }
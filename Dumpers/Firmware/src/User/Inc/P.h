@@ -15,7 +15,7 @@ void P_Dump(void);
 void P_Erase(void);
 void P_CapaView(void);
 
-void P_Program_Internal(const char *filename, uint32_t address);
+void P_Program_Internal(const char *filename, int resume);
 
 #ifdef __cplusplus
 }
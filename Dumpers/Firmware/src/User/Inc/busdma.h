@@ -0,0 +1,28 @@
+#ifndef __BUSDMA_H
+#define __BUSDMA_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* words per burst, bursts must not cross a BUSDMA_BURST aligned boundary */
+#define BUSDMA_BURST       0x1000
+/* bus cycle length and sample point in ns */
+#define BUSDMA_CYCLE_NS    200
+#define BUSDMA_SAMPLE_NS   180
+/* burst timeout in ms */
+#define BUSDMA_TIMEOUT     10
+
+/* staging buffers, [slot][word] */
+extern uint8_t busdma_lo[2][BUSDMA_BURST];
+extern uint8_t busdma_hi[2][BUSDMA_BURST];
+
+void BUSDMA_Init(void);
+int BUSDMA_Start(uint32_t count);
+int BUSDMA_Wait(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BUSDMA_H */
@@ -0,0 +1,18 @@
+#ifndef __CRC32_H
+#define __CRC32_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+void CRC32_Init(void);
+void CRC32_Start(void);
+void CRC32_Update(const void *data, uint32_t length);
+uint32_t CRC32_Value(void);
+uint32_t CRC32_Buffer(const void *data, uint32_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CRC32_H */
@@ -25,10 +25,18 @@ typedef struct Flash_ID {
 // de/scramble address
 //#define DE_SCRAMBLE_ADDR_P
 
+// timer/DMA paced bus reads for dumps, comment out to use CPU read cycles
+#define BUS_DMA_READ
+
+// copy the status records shown on the LCD to the USB CDC port as text
+//#define STATUS_USB_MIRROR
+
 #define CHIP_NAME_P     "P-ROM"
 #define DUMP_FILENAME_P "prom.dump"
 #define PROG_FILENAME_P "prom"
+#ifndef END_ADDRESS_P
 #define END_ADDRESS_P   (0x8000000 / 2) // 128 meg
+#endif
 
 #define CHIP_NAME_S     "S-ROM"
 #define DUMP_FILENAME_S "srom.dump"
@@ -43,11 +51,15 @@ typedef struct Flash_ID {
 
 #define CHIP_NAME_C     "C-ROM"
 #define DUMP_FILENAME_C "crom.dump"
+#ifndef END_ADDRESS_C
 #define END_ADDRESS_C   (0x40000000 / 4) // 1 gig
+#endif
 
 #define CHIP_NAME_V     "V-ROM"
 #define DUMP_FILENAME_V "vrom.dump"
+#ifndef END_ADDRESS_V
 #define END_ADDRESS_V   (0x40000000 / 4) // 1 gig
+#endif
 
 #define VERSION "2"
 
@@ -0,0 +1,26 @@
+#ifndef __DELTA_H
+#define __DELTA_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* changed sector list of an image: <image name> + DLT_EXT */
+#define DLT_EXT           ".dlt"
+/* build id and image last programmed onto a chip type: <dump name without extension> + DLT_LAST_EXT */
+#define DLT_LAST_EXT      ".last"
+#define DLT_VERSION       1
+/* sectors in a list (full C/V-ROM) */
+#define DLT_MAX_SECTORS   2048
+
+FRESULT DLT_Load(chip_t chiptype, const char *image, uint32_t sector, uint32_t sectors, uint32_t *changed);
+int DLT_IsChanged(uint32_t index);
+int DLT_Offer(chip_t chiptype, const char *image, uint32_t sector, uint32_t sectors);
+void DLT_Forget(chip_t chiptype);
+FRESULT DLT_Programmed(chip_t chiptype, const char *image, uint32_t sector);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DELTA_H */
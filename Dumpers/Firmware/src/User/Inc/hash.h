@@ -0,0 +1,21 @@
+#ifndef __HASH_H
+#define __HASH_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* checksums of a dump: <dump name without extension> + HASH_EXT */
+#define HASH_EXT          ".crc"
+/* layout report written by the compiler, for the per-game ranges */
+#define HASH_LOG_FILE     "VTXCart.log"
+#define HASH_MAX_GAMES    256
+#define HASH_NAME_LEN     28
+
+FRESULT HASH_Save(chip_t chiptype, uint32_t sector, uint32_t sectors, uint32_t *crc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HASH_H */
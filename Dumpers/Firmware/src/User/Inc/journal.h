@@ -0,0 +1,28 @@
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#define JRN_VERSION       1
+/* sectors in the bitmap (full C/V-ROM) */
+#define JRN_MAX_SECTORS   2048
+#define JRN_NAME_LEN      128
+/* flush interval while programming, in ticks (10ms) */
+#define JRN_FLUSH_TICKS   500
+
+FRESULT JRN_Load(char *image, chip_t *chiptype, uint32_t *done, uint32_t *sectors);
+FRESULT JRN_Begin(const char *image, chip_t chiptype, uint32_t sectors, int resume);
+int JRN_IsDone(uint32_t index);
+uint32_t JRN_Next(uint32_t index);
+void JRN_Done(uint32_t index);
+FRESULT JRN_Flush(void);
+FRESULT JRN_Close(void);
+void JRN_Delete(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JOURNAL_H */
@@ -25,6 +25,16 @@
 #include "sd_diskio.h"
 
 #include "fatfs.h"
+#include "stream.h"
+#include "busdma.h"
+#include "scramble.h"
+#include "prof.h"
+#include "crc32.h"
+#include "manifest.h"
+#include "hash.h"
+#include "journal.h"
+#include "delta.h"
+#include "status.h"
 
 #include "st7735.h"
 #include "lcd.h"
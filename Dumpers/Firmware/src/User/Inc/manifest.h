@@ -0,0 +1,35 @@
+#ifndef __MANIFEST_H
+#define __MANIFEST_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* manifest of an image: <image name> + MAN_EXT */
+#define MAN_EXT           ".man"
+#define MAN_VERSION       1
+/* sectors in a manifest written by the programmer (full C/V-ROM) */
+#define MAN_MAX_SECTORS   2048
+
+/* header flags */
+#define MAN_FLAG_SCRAMBLED  0x1     /* C/P image is in chip bus order */
+
+typedef struct {
+  FIL file;
+  uint32_t sector;                  /* bytes per sector */
+  uint32_t flags;
+} manifest_t;
+
+FRESULT MAN_Open(manifest_t *m, const char *image, uint32_t sector);
+int MAN_Next(manifest_t *m, uint32_t *crc);
+void MAN_Close(manifest_t *m);
+void MAN_Record(uint32_t index, uint32_t crc, int blank);
+uint32_t MAN_SectorCrc(uint32_t index);
+uint32_t MAN_Flags(const char *image, uint32_t sector);
+FRESULT MAN_Save(const char *image, uint32_t sector, uint32_t sectors, uint32_t flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MANIFEST_H */
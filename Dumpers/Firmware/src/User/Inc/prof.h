@@ -0,0 +1,56 @@
+#ifndef __PROF_H
+#define __PROF_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* what the CPU is spending its time on; exactly one counter runs at a time */
+typedef enum {
+  PROF_OTHER = 0,
+  PROF_BUS,         /* flash data read/write cycles, including de/scrambling */
+  PROF_SD_READ,     /* waiting for image data */
+  PROF_SD_WRITE,    /* waiting for dump data to be written */
+  PROF_ERASE,       /* waiting for a block erase */
+  PROF_PROGRAM,     /* waiting for a buffer program */
+  PROF_STATUS,      /* other status polling (unlock, blank check) */
+  PROF_LCD,         /* LCD refresh from the timer interrupt */
+  PROF_COUNTERS
+} prof_counter_t;
+
+/* sectors in the per-sector log (full C/V-ROM) */
+#define PROF_LOG_SIZE 2048
+
+typedef struct {
+  uint32_t addr;
+  uint32_t us[PROF_COUNTERS];
+} prof_sector_t;
+
+extern prof_counter_t prof_current;
+extern volatile uint32_t prof_isr_cycles[PROF_COUNTERS];
+
+void PROF_Start(void);
+prof_counter_t PROF_Switch(prof_counter_t counter);
+void PROF_Sector(uint32_t addr);
+FRESULT PROF_Save(const char *job, chip_t chiptype);
+void PROF_Summary(void);
+
+/* status polling, unless it is part of an erase/program wait */
+static inline prof_counter_t PROF_Poll(void) {
+  if(prof_current == PROF_ERASE || prof_current == PROF_PROGRAM) {
+    return prof_current;
+  }
+  return PROF_Switch(PROF_STATUS);
+}
+
+/* interrupt handlers account their own time, it is taken out of whatever
+   the foreground was doing */
+static inline void PROF_Isr(prof_counter_t counter, uint32_t start) {
+  prof_isr_cycles[counter] += DWT->CYCCNT - start;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PROF_H */
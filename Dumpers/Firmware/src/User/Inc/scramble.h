@@ -0,0 +1,30 @@
+#ifndef __SCRAMBLE_H
+#define __SCRAMBLE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* data line de/scramble tables, [low byte] | [high byte] */
+extern uint16_t cv_scr_lo[256], cv_scr_hi[256];
+extern uint16_t cv_desc_lo[256], cv_desc_hi[256];
+extern uint16_t p_scr_lo[256], p_scr_hi[256];
+extern uint16_t p_desc_lo[256], p_desc_hi[256];
+
+/* selected tables, NULL = no scrambling */
+extern const uint16_t *scramble_lo;
+extern const uint16_t *scramble_hi;
+
+/* de/scramble a single word with the selected tables */
+static inline uint16_t SCRAMBLE_Word(uint16_t w) {
+  if(!scramble_lo) return w;
+  return scramble_lo[w & 0xff] | scramble_hi[w >> 8];
+}
+
+void SCRAMBLE_Select(const uint16_t *lo, const uint16_t *hi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SCRAMBLE_H */
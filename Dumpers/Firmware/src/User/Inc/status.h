@@ -0,0 +1,56 @@
+#ifndef __STATUS_H
+#define __STATUS_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* records between two LCD refreshes, power of two */
+#define STATUS_RING_SIZE  64
+
+/* what a status record says; the text and screen line are in status.c */
+typedef enum {
+  STATUS_CLEAR = 0,     /* blank the error line */
+  STATUS_PROGRAMMING,   /* w0 = percent */
+  STATUS_VERIFYING,
+  STATUS_DUMPING,
+  STATUS_BLANK,         /* addr, w0 = halfword */
+  STATUS_BLANK_SR,      /* w0/w1 = status registers */
+  STATUS_BLANK_DIFF,    /* addr, w0 = data */
+  STATUS_ERASE,         /* addr, w0 = halfword, w1 = try */
+  STATUS_ERASE_P,       /* addr, w0 = try */
+  STATUS_ERASE_SR,
+  STATUS_ERASE_SR_P,
+  STATUS_ERASE_RETRY,   /* addr, w0 = halfword, w1 = try */
+  STATUS_ERASE_CHIPS,   /* w0/w1/addr >> 16/addr & 0xffff = block of CE1-4 */
+  STATUS_ERASE_TIMEOUT,
+  STATUS_ERASE_LOCKED,  /* addr, w0 = halfword */
+  STATUS_VERIFY,        /* addr, w0 = halfword */
+  STATUS_VERIFY_P,      /* addr */
+  STATUS_VERIFY_DIFF,   /* w0 = read, w1 = expected */
+  STATUS_PROGRAM,       /* addr, w0 = halfword */
+  STATUS_PROGRAM_P,     /* addr */
+  STATUS_PROGRAM_SR,
+  STATUS_PROGRAM_SR_P,
+  STATUS_PROGRAM_RETRY, /* w0 = halfwords */
+  STATUS_PROGRAM_OK,
+  STATUS_DUMP,          /* addr */
+  STATUS_DUMP_DMA,      /* addr, DMA read failed */
+  STATUS_EVENTS
+} status_event_t;
+
+typedef struct {
+  uint32_t addr;
+  uint16_t w[2];
+  uint8_t event;
+} status_rec_t;
+
+void STATUS_Post(status_event_t event, uint32_t addr, uint16_t w0, uint16_t w1);
+int STATUS_Pending(void);
+void STATUS_Drain(int show);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATUS_H */
@@ -21,6 +21,8 @@ void USART3_IRQHandler(void);
 void SDMMC1_IRQHandler(void);
 void OTG_FS_IRQHandler(void);
 void TIM1_UP_IRQHandler(void);
+void DMA1_Stream0_IRQHandler(void);
+void SPI4_IRQHandler(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,56 @@
+#ifndef __STREAM_H
+#define __STREAM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* DMA transfer unit, must be a multiple of the SD block size (512) */
+#define STREAM_CHUNK       0x8000
+/* dump pipeline stage, bus read of one stage overlaps SD write of the previous */
+#define STREAM_DUMP_CHUNK  0x10000
+/* cluster link map entries, (fragments + 1) * 2 */
+#define STREAM_CLMT_SIZE   64
+/* timeout for a pending chunk in timer ticks (10ms) */
+#define STREAM_TIMEOUT     200
+/* files of a split image set (crom-1, crom-2, ...) read as one stream */
+#define STREAM_MAX_PARTS   4
+/* part of an image larger than one job, "crom:2"; not allowed in file names */
+#define STREAM_PART_SEP    ':'
+/* image name with part number */
+#define STREAM_NAME_LEN    (FF_MAX_LFN + 8)
+
+typedef struct {
+  FIL *file;
+  DWORD clmt[STREAM_CLMT_SIZE];
+  FSIZE_t base;                     /* image offset of the part being programmed */
+  FSIZE_t size;                     /* image size, all files of a set */
+  uint8_t parts;                    /* files in the set */
+  uint8_t fastpath;                 /* cluster map available, DMA transfers possible */
+  uint8_t write;                    /* current job direction */
+  uint8_t *dst;                     /* buffer of current job */
+  FSIZE_t ofs;                      /* image offset of current job */
+  uint32_t length;                  /* bytes requested (buffer size) */
+  uint32_t valid;                   /* bytes of file data available (EOF clipped) */
+  uint32_t requested;               /* bytes issued to the card so far */
+  uint32_t chunk;                   /* size of transfer in flight */
+  volatile uint32_t done;           /* bytes landed */
+  volatile uint8_t busy;            /* DMA transfer in flight */
+  volatile uint8_t error;
+} stream_t;
+
+FRESULT STREAM_Open(stream_t *s, FIL *file);
+uint32_t STREAM_ImageName(const char *image, char *name);
+FRESULT STREAM_OpenImage(stream_t *s, FIL *file, const char *image, FSIZE_t job);
+FRESULT STREAM_Create(stream_t *s, FIL *file, FSIZE_t size);
+FRESULT STREAM_Start(stream_t *s, void *dst, FSIZE_t ofs, uint32_t length);
+FRESULT STREAM_Write(stream_t *s, const void *src, FSIZE_t ofs, uint32_t length);
+FRESULT STREAM_Sync(stream_t *s, uint32_t bytes);
+int STREAM_IsBlank(stream_t *s, uint32_t bytes);
+void STREAM_Close(stream_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STREAM_H */
@@ -17,8 +17,7 @@ uint32_t get_end_address (void);
 void waitButton(void);
 int waitYesNo(void);
 
-FRESULT saveProgress(uint32_t addr, const char *filename, chip_t chiptype);
-FRESULT loadProgress(uint32_t *addr, char *filename, chip_t *chiptype);
+int is_sidecar_file(const char *name);
 
 #ifdef __cplusplus
 }
@@ -8,6 +8,7 @@
 // MX Handles
 extern UART_HandleTypeDef huart3;
 extern SPI_HandleTypeDef hspi4;
+extern DMA_HandleTypeDef hdma_spi4_tx;
 extern SD_HandleTypeDef hsd1;
 extern PCD_HandleTypeDef hpcd_USB_OTG_FS;
 extern USBD_HandleTypeDef hUsbDeviceFS;
@@ -68,8 +69,7 @@ extern uint32_t flg_seek;
 extern const char *CHIP_NAMES[];
 extern const char *DUMP_FILENAMES[];
 
-// scrable lookup tables
-extern uint16_t scramble_lookup[65536] D2SRAM_BUFFER;
+// address scramble lookup table
 extern uint16_t addr_lookup[512];
 
 #ifdef __cplusplus
@@ -235,54 +235,6 @@ static const int ctrl_capa_thres[2][11] = {
   }
 };
 
-uint16_t cv_desc_data(uint16_t dat) // china pinout descramble
-{
-  uint16_t data = 0;
-
-  if (dat & BIT0)  data |= BIT12;
-  if (dat & BIT1)  data |= BIT9;
-  if (dat & BIT2)  data |= BIT8;
-  if (dat & BIT3)  data |= BIT2;
-  if (dat & BIT4)  data |= BIT14;
-  if (dat & BIT5)  data |= BIT0;
-  if (dat & BIT6)  data |= BIT15;
-  if (dat & BIT7)  data |= BIT4;
-  if (dat & BIT8)  data |= BIT1;
-  if (dat & BIT9)  data |= BIT5;
-  if (dat & BIT10) data |= BIT13;
-  if (dat & BIT11) data |= BIT3;
-  if (dat & BIT12) data |= BIT7;
-  if (dat & BIT13) data |= BIT6;
-  if (dat & BIT14) data |= BIT11;
-  if (dat & BIT15) data |= BIT10;
-
-  return data;
-}
-
-uint16_t cv_scr_data(uint16_t dat) // china pinout scramble
-{
-  uint16_t data = 0;
-
-  if (dat & BIT0)  data |= BIT5;
-  if (dat & BIT1)  data |= BIT8;
-  if (dat & BIT2)  data |= BIT3;
-  if (dat & BIT3)  data |= BIT11;
-  if (dat & BIT4)  data |= BIT7;
-  if (dat & BIT5)  data |= BIT9;
-  if (dat & BIT6)  data |= BIT13;
-  if (dat & BIT7)  data |= BIT12;
-  if (dat & BIT8)  data |= BIT2;
-  if (dat & BIT9)  data |= BIT1;
-  if (dat & BIT10) data |= BIT15;
-  if (dat & BIT11) data |= BIT14;
-  if (dat & BIT12) data |= BIT0;
-  if (dat & BIT13) data |= BIT10;
-  if (dat & BIT14) data |= BIT4;
-  if (dat & BIT15) data |= BIT6;
-
-  return data;
-}
-
 static inline void CV_nCE(uint32_t st)
 {
   GPIOD -> BSRR = (0x1b << 16) | (st & 0x3) | ((st & 0xc) << 1);
@@ -464,6 +416,22 @@ void CV_WriteCycle(uint8_t halfword, uint32_t addr, uint16_t data)
   CV_nCE(0x0F);
 }
 
+/**
+ * Read the status word of a single chip (one halfword of a chip pair)
+ * @param halfword 1 = lower word, 2 = upper word
+ * @param addr select upper or lower half of storage space (A27)
+ *
+ * @return status word as currently output by the chip
+ */
+static uint16_t CV_ReadStatus(uint8_t halfword, uint32_t addr) {
+  /* speed up data line pull-down in case chip has gone High-Z
+     to prevent previous bus data from being mistaken as status word */
+  CV_SetData(0x0000);
+  DATADIR_OUT();
+  DATADIR_IN();
+  return CV_ReadCycle(halfword, addr);
+}
+
 /**
  * Wait for status bit to be set on a chip pair (selectable single/dual word, pair
  * identified by halfword(s) and address MSB)
@@ -479,23 +447,14 @@ int CV_WaitStatus(uint16_t *status, uint8_t halfword, uint32_t addr, uint16_t ma
   int result = 0;
   uint16_t data[2] = { 0xffff, 0xffff };
   uint32_t endtime = ticks + timeout;
+  prof_counter_t prof = PROF_Poll();
 
   do {
     if(halfword & 1) {
-      /* speed up data line pull-down in case chip has gone High-Z
-         to prevent previous bus data from being mistaken as status word */
-      CV_SetData(0x0000);
-      DATADIR_OUT();
-      DATADIR_IN();
-      data[0] = CV_ReadCycle(1, addr);
+      data[0] = CV_ReadStatus(1, addr);
     }
     if(halfword & 2) {
-      /* speed up data line pull-down in case chip has gone High-Z
-         to prevent previous bus data from being mistaken as status word */
-      CV_SetData(0x0000);
-      DATADIR_OUT();
-      DATADIR_IN();
-      data[1] = CV_ReadCycle(2, addr);
+      data[1] = CV_ReadStatus(2, addr);
     }
 
     if(ticks > endtime) {
@@ -517,6 +476,7 @@ int CV_WaitStatus(uint16_t *status, uint8_t halfword, uint32_t addr, uint16_t ma
     result |= 2;
   }
 
+  PROF_Switch(prof);
   return result;
 }
 
@@ -548,7 +508,7 @@ int CV_SectorBlankCheck(uint8_t halfword, uint32_t addr) {
   CV_WriteCycle(halfword, addr, 0x60);
   CV_WriteCycle(halfword, addr, 0xd0);
   CV_WaitStatus(sr, halfword, addr, 0x80, 10);
-  LCD_xyprintf(0, 1, 0, "BC %08lx.%d     \n", addr, halfword);
+  STATUS_Post(STATUS_BLANK, addr, halfword, 0);
   CV_WriteCycle(halfword, addr, 0xbc);
   CV_WriteCycle(halfword, addr, 0xd0);
   CV_WaitStatus(sr, halfword, addr, 0x80, 500);
@@ -556,9 +516,9 @@ int CV_SectorBlankCheck(uint8_t halfword, uint32_t addr) {
   if(sr[1] != 0x80) res |= 2;
   res &= halfword;
   if(res) {
-    LCD_xyprintf(0, 2, 1, "BC sr=%04x %04x\n", sr[0], sr[1]);
+    STATUS_Post(STATUS_BLANK_SR, 0, sr[0], sr[1]);
   } else {
-    LCD_xyprintf(0, 2, 1, "                    \n");
+    STATUS_Post(STATUS_CLEAR, 0, 0, 0);
   }
   return res;
 }
@@ -567,6 +527,7 @@ uint32_t CV_SectorErase(uint8_t halfword, uint32_t addr)
 {
   uint16_t sr[2];
   uint32_t res = 0;
+  prof_counter_t prof;
 
   int try = 0;
   int dirty = halfword;
@@ -575,14 +536,16 @@ uint32_t CV_SectorErase(uint8_t halfword, uint32_t addr)
     CV_WriteCycle(dirty, addr, 0x60);
     CV_WriteCycle(dirty, addr, 0xd0);
     CV_WaitStatus(sr, dirty, addr, 0x80, 10);
-    LCD_xyprintf(0, 1, 0, "ER %08lx.%d [%d]\n", addr, dirty, try++);
+    STATUS_Post(STATUS_ERASE, addr, dirty, try++);
     CV_WriteCycle(dirty, addr, 0x20);
     CV_WriteCycle(dirty, addr, 0xd0);
+    prof = PROF_Switch(PROF_ERASE);
     Delay_us(100);
     res = CV_WaitStatus(sr, dirty, addr, 0x80, 500);
+    PROF_Switch(prof);
     if(res) {
       CV_Reset();
-      LCD_printf(0, "ER Timeout          \n");
+      LCD_xyprintf(0, 2, 0, "ER Timeout          \n");
       CV_SectorBlankCheck(dirty, addr);
       if(flag_button & FLAG_BTN_BRD_LONG) {
         flag_button &= ~(FLAG_BTN_BRD_LONG);
@@ -605,7 +568,7 @@ uint32_t CV_SectorErase(uint8_t halfword, uint32_t addr)
     if(sr[0] == 0x80) dirty &= ~1;
     if(sr[1] == 0x80) dirty &= ~2;
     if(dirty) {
-      LCD_xyprintf(0, 2, 1, "ER sr=%04x %04x\n", sr[0], sr[1]);
+      STATUS_Post(STATUS_ERASE_SR, 0, sr[0], sr[1]);
       CV_SectorBlankCheck(dirty, addr);
       CV_Reset();
     }
@@ -622,29 +585,44 @@ abort:
   return res;
 }
 
-int CV_SectorVerify(uint8_t halfword, uint32_t addr, uint16_t *buffer) {
+/**
+ * @brief Compare a sector against the buffer contents, scrambling them on the fly
+ *
+ * @param halfword select halfword to verify (1 = low, 2 = high, 3 = full word)
+ * @param addr sector address
+ * @param buffer sector buffer
+ * @param stream if not NULL, buffer is still being loaded by this stream;
+ *               wait for each chunk before comparing against it
+ * @return int bitmask of mismatching halfwords
+ */
+int CV_SectorVerify(uint8_t halfword, uint32_t addr, uint16_t *buffer, stream_t *stream) {
   uint16_t data, compare;
   uint32_t src;
   int dirty = 0;
 
   CV_WriteCycle(3, addr, 0x50);
   CV_WriteCycle(3, addr, 0xff);
-  LCD_xyprintf(0, 1, 0, "VR %08lx.%d       \r", addr, halfword);
+  STATUS_Post(STATUS_VERIFY, addr, halfword, 0);
   for(int j = 0; j < SECTOR_SIZE; j++) {
+    if(stream && !(j & (STREAM_CHUNK / 4 - 1))) {
+      if(STREAM_Sync(stream, (j * 4) + STREAM_CHUNK) != FR_OK) {
+        return halfword;
+      }
+    }
     src = (j & ~0x1ff) | addr_lookup[j & 0x1ff];
     if((halfword & 1) && !(dirty & 1)) {
       data = CV_ReadCycle(1, addr+j);
-      compare = buffer[src*2];
+      compare = SCRAMBLE_Word(buffer[src*2]);
       if(data != compare) {
-        LCD_xyprintf(0, 2, 3, "VR %04x != %04x\r", data, compare);
+        STATUS_Post(STATUS_VERIFY_DIFF, 0, data, compare);
         dirty |= 1;
       }
     }
     if((halfword & 2) && !(dirty & 2)) {
       data = CV_ReadCycle(2, addr+j);
-      compare = buffer[src*2+1];
+      compare = SCRAMBLE_Word(buffer[src*2+1]);
       if(data != compare) {
-        LCD_xyprintf(0, 2, 3, "VR %04x != %04x\r", data, compare);
+        STATUS_Post(STATUS_VERIFY_DIFF, 0, data, compare);
         dirty |= 2;
       }
     }
@@ -653,71 +631,248 @@ int CV_SectorVerify(uint8_t halfword, uint32_t addr, uint16_t *buffer) {
   return dirty;
 }
 
+/**
+ * @brief Combined erase check and diff check of a sector prior to programming,
+ *        per halfword. A halfword that differs only in bits the buffer clears
+ *        can be programmed over the current contents without an erase.
+ *
+ * @param halfword select halfword to check (1 = low, 2 = high, 3 = full word)
+ * @param addr sector address
+ * @param buffer sector buffer
+ * @param stream if not NULL, buffer is still being loaded by this stream;
+ *               wait for each chunk before comparing against it
+ * @return int bits 1:0 = halfwords that need programming,
+ *             bits 3:2 = halfwords of those that need an erase first
+ */
+int CV_SectorCheckForProgram(uint8_t halfword, uint32_t addr, uint16_t *buffer, stream_t *stream) {
+  uint16_t data, compare;
+  uint32_t src;
+  int need_program = 0;
+  int need_erase = 0;
+
+  CV_WriteCycle(3, addr, 0x50);
+  CV_WriteCycle(3, addr, 0xff);
+  STATUS_Post(STATUS_VERIFY, addr, halfword, 0);
+  for(int j = 0; j < SECTOR_SIZE; j++) {
+    if(stream && !(j & (STREAM_CHUNK / 4 - 1))) {
+      if(STREAM_Sync(stream, (j * 4) + STREAM_CHUNK) != FR_OK) {
+        return halfword | (halfword << 2);
+      }
+    }
+    src = (j & ~0x1ff) | addr_lookup[j & 0x1ff];
+    for(int hw = 0; hw < 2; hw++) {
+      uint8_t half = hw + 1;
+      if(!(halfword & half) || (need_erase & half)) continue;
+      data = CV_ReadCycle(half, addr+j);
+      compare = SCRAMBLE_Word(buffer[src*2+hw]);
+      if(data != compare) {
+        if(!(need_program & half)) {
+          STATUS_Post(STATUS_VERIFY_DIFF, 0, data, compare);
+        }
+        need_program |= half;
+        if((data | compare) != data) {
+          need_erase |= half;
+        }
+      }
+    }
+    if(need_erase == halfword) break;
+  }
+  return need_program | (need_erase << 2);
+}
+
+/**
+ * @brief Load one region into the write buffer of a single chip and confirm it
+ *
+ * The chip starts programming the region after the confirm command; completion
+ * has to be polled separately (SR.7) so the other chip can be serviced meanwhile.
+ *
+ * @param halfword 1 = low, 2 = high
+ * @param addr region address
+ * @param buf sector buffer offset to the region start
+ * @return int 0 on success, 1 if the write buffer did not become available
+ */
+static int CV_RegionLoad(uint8_t halfword, uint32_t addr, uint16_t *buf) {
+  uint16_t sr[2];
+  int hw = halfword - 1;
+
+  CV_WriteCycle(halfword, addr, 0xe9);
+  if(CV_WaitStatus(sr, halfword, addr, 0x0080, 10)) {
+    return 1;
+  }
+  CV_WriteCycle(halfword, addr, REGION_SIZE - 1);
+  for(int d = 0; d < REGION_SIZE; d++) {
+    CV_WriteCycle(halfword, addr + d, SCRAMBLE_Word(buf[addr_lookup[d]*2 + hw]));
+  }
+  CV_WriteCycle(halfword, addr, 0xd0);
+  return 0;
+}
+
 /**
  * @brief Program a sector on one or both half words
  *
+ * The two halfwords are separate chips with their own command interface.
+ * Instead of loading both buffers and waiting for both to finish, the chips
+ * are serviced alternately: while one chip executes a buffer program, the
+ * write buffer of the other chip is loaded. Status is tracked per chip so a
+ * failing chip drops out without holding up the other one.
+ *
  * @param halfword select halfword to program (1 = low, 2 = high, 3 = full word)
  * @param addr sector address
  * @return int bitmask of failed halfwords
  */
 int CV_SectorProgram(uint8_t halfword, uint32_t addr, uint16_t *buf) {
-  uint16_t sr[2];
-  uint16_t data1, data2;
-  uint32_t addr_final;
-  int src;
-
+  struct {
+    uint32_t region;   /* offset of region currently loaded/programming */
+    uint32_t endtime;  /* timeout for current buffer program */
+    uint16_t sr;       /* last status word */
+    uint8_t busy;      /* buffer program confirmed, not finished yet */
+  } die[2] = { { 0, 0, 0x80, 0 }, { 0, 0, 0x80, 0 } };
   int active = halfword;
-  LCD_xyprintf(0, 1, 0, "PG %08lx.%d\n", addr, active);
-  for(int j = 0; j < SECTOR_SIZE; j += REGION_SIZE) {
-    CV_WriteCycle(active, addr+j, 0x50);
-    CV_WriteCycle(active, addr+j, 0x60);
-    CV_WriteCycle(active, addr+j, 0xd0);
-    CV_WaitStatus(sr, active, addr+j, 0x0080, 10);
-    CV_WriteCycle(active, addr+j, 0xe9);
-    CV_WaitStatus(sr, active, addr+j, 0x0080, 10);
-    CV_WriteCycle(active, addr+j, 0x1ff);
-    for(int d = 0; d < 512; d++) {
-      src = addr_lookup[d];
-      addr_final = addr + j + d;
-
-      data1 = buf[(j+src)*2];
-      data2 = buf[(j+src)*2+1];
-      if(active & 1) {
-        CV_WriteCycle(1, addr_final, data1);
+  int pending = halfword;
+  prof_counter_t prof = PROF_Switch(PROF_PROGRAM);
+
+  STATUS_Post(STATUS_PROGRAM, addr, active, 0);
+  CV_WriteCycle(active, addr, 0x50);
+  CV_WriteCycle(active, addr, 0x60);
+  CV_WriteCycle(active, addr, 0xd0);
+  CV_WaitStatus(NULL, active, addr, 0x0080, 10);
+
+  while(pending) {
+    for(int hw = 0; hw < 2; hw++) {
+      uint8_t half = hw + 1;
+      if(!(pending & half)) continue;
+      if(die[hw].busy) {
+        die[hw].sr = CV_ReadStatus(half, addr + die[hw].region);
+        if(!(die[hw].sr & 0x80)) {
+          if(ticks > die[hw].endtime) {
+            active &= ~half;
+            pending &= ~half;
+          }
+          continue;
+        }
+        die[hw].busy = 0;
+        CV_WriteCycle(half, addr + die[hw].region, 0x50);
+        if(die[hw].sr != 0x80) {
+          active &= ~half;
+          pending &= ~half;
+          continue;
+        }
+        die[hw].region += REGION_SIZE;
+        if(die[hw].region >= SECTOR_SIZE) {
+          pending &= ~half;
+          continue;
+        }
       }
-      if(active & 2) {
-        CV_WriteCycle(2, addr_final, data2);
+      PROF_Switch(PROF_BUS);
+      if(CV_RegionLoad(half, addr + die[hw].region, buf + die[hw].region * 2)) {
+        PROF_Switch(PROF_PROGRAM);
+        die[hw].sr = 0;
+        active &= ~half;
+        pending &= ~half;
+        continue;
       }
+      PROF_Switch(PROF_PROGRAM);
+      die[hw].busy = 1;
+      die[hw].endtime = ticks + 10;
+    }
+  }
+  if(active != halfword) {
+    STATUS_Post(STATUS_PROGRAM_SR, 0, die[0].sr, die[1].sr);
+  } else {
+    STATUS_Post(STATUS_CLEAR, 0, 0, 0);
+  }
+  CV_WriteCycle(halfword, addr, 0x50);
+  PROF_Switch(prof);
+  return (~active) & 3 & halfword;
+}
+
+#ifdef BUS_DMA_READ
+/* Descramble a finished burst from the staging buffers into one halfword of the buffer */
+static void CV_MergeBurst(uint16_t *buffer, uint8_t hw, int slot) {
+  const uint8_t *lo = busdma_lo[slot];
+  const uint8_t *hi = busdma_hi[slot];
+  const uint16_t *scr_lo = scramble_lo;
+  const uint16_t *scr_hi = scramble_hi;
+
+  if(scr_lo) {
+    for(int j = 0; j < BUSDMA_BURST; j++) {
+      buffer[((j & ~0xf) | addr_lookup[j & 0xf]) * 2 + hw] = scr_lo[lo[j]] | scr_hi[hi[j]];
     }
-    CV_WriteCycle(active, addr+j, 0xd0);
-    CV_WaitStatus(sr, active, addr+j, 0x0080, 10);
-    if(((active & 1) && sr[0] != 0x80)
-     ||((active & 2) && sr[1] != 0x80)) {
-      LCD_xyprintf(0, 2, 1, "PG sr=%04x %04x\n", sr[0], sr[1]);
+  } else {
+    for(int j = 0; j < BUSDMA_BURST; j++) {
+      buffer[((j & ~0xf) | addr_lookup[j & 0xf]) * 2 + hw] = lo[j] | (hi[j] << 8);
     }
-    CV_WriteCycle(active, addr+j, 0x50);
-    if(sr[0] != 0x80) active &= ~1;
-    if(sr[1] != 0x80) active &= ~2;
-    if(!active) {
-      break;
+  }
+}
+
+/**
+ * Timer/DMA paced read of a block, both halfwords. The previous burst is
+ * merged into the buffer while the next one is running.
+ * @return 0 = OK, 1 = DMA error
+ */
+static int CV_SectorDumpDMA(uint32_t addr, uint16_t *buffer, uint32_t count) {
+  uint16_t *pbuf = NULL;
+  uint8_t phw = 0;
+  int slot, pslot = 0;
+  uint32_t a;
+
+  for(uint32_t j = 0; j < count; j += BUSDMA_BURST) {
+    a = addr + j;
+    for(uint8_t halfword = 1; halfword <= 2; halfword++) {
+      CV_SetAddress(a);
+      CV_nCE(CV_ADDR2ST(halfword, a));
+      CV_nOE(CV_ADDR2ST(halfword, a));
+      slot = BUSDMA_Start(BUSDMA_BURST);
+      if(slot >= 0 && pbuf) {
+        CV_MergeBurst(pbuf, phw, pslot);
+      }
+      if(slot < 0 || BUSDMA_Wait()) {
+        CV_nOE(0x0F);
+        CV_nCE(0x0F);
+        return 1;
+      }
+      CV_nOE(0x0F);
+      CV_nCE(0x0F);
+      pbuf = buffer + j * 2;
+      phw = halfword - 1;
+      pslot = slot;
     }
   }
-  if(active & halfword)LCD_xyprintf(0, 2, 0, "                    \n");
-  return (~active) & 3 & halfword;
+  if(pbuf) {
+    CV_MergeBurst(pbuf, phw, pslot);
+  }
+  return 0;
 }
+#endif
 
-void CV_SectorDump(uint32_t addr, uint16_t *buffer) {
+/**
+ * @brief Read a block of words from the chip into the buffer
+ *
+ * @param addr start address (multiple of 16)
+ * @param buffer destination buffer
+ * @param count number of words to read (multiple of 16)
+ */
+void CV_SectorDump(uint32_t addr, uint16_t *buffer, uint32_t count) {
   uint32_t src;
   uint16_t data;
   CV_WriteCycle(3, addr, 0x50);
   CV_WriteCycle(3, addr, 0xff);
-  LCD_xyprintf(0, 1, 0, "DP %08lx         \r", addr);
-  for(int j = 0; j < SECTOR_SIZE; j++) {
+  STATUS_Post(STATUS_DUMP, addr, 0, 0);
+#ifdef BUS_DMA_READ
+  if(!(addr % BUSDMA_BURST) && !(count % BUSDMA_BURST)) {
+    if(!CV_SectorDumpDMA(addr, buffer, count)) {
+      return;
+    }
+    /* fall back to CPU read cycles */
+    STATUS_Post(STATUS_DUMP_DMA, addr, 0, 0);
+  }
+#endif
+  for(int j = 0; j < count; j++) {
     src = (j & ~0xf) | addr_lookup[j & 0xf];
     data = CV_ReadCycle(1, addr+j);
-    buffer[src*2] = data;
+    buffer[src*2] = SCRAMBLE_Word(data);
     data = CV_ReadCycle(2, addr+j);
-    buffer[src*2+1] = data;
+    buffer[src*2+1] = SCRAMBLE_Word(data);
   }
 }
 
@@ -785,6 +940,8 @@ void CV_GetLineCapacitances(int *addr, int *data, int *ctrl) {
   SysTick->CTRL &= ~(SysTick_CTRL_ENABLE_Msk);
   NVIC_DisableIRQ(TIM1_UP_IRQn);
   NVIC_DisableIRQ(OTG_FS_WKUP_IRQn);
+  NVIC_DisableIRQ(SPI4_IRQn);
+  NVIC_DisableIRQ(DMA1_Stream0_IRQn);
   NVIC_ClearPendingIRQ(TIM1_UP_IRQn);
   NVIC_ClearPendingIRQ(OTG_FS_WKUP_IRQn);
 
@@ -897,6 +1054,8 @@ void CV_GetLineCapacitances(int *addr, int *data, int *ctrl) {
   __DSB(); __DMB(); __ISB();
   NVIC_EnableIRQ(TIM1_UP_IRQn);
   NVIC_EnableIRQ(OTG_FS_WKUP_IRQn);
+  NVIC_EnableIRQ(SPI4_IRQn);
+  NVIC_EnableIRQ(DMA1_Stream0_IRQn);
   SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
 
   /* revert to normal GPIO operation */
@@ -1273,20 +1432,121 @@ void CV_CapaView() {
   CV_GPIO_Init();
 }
 
+/**
+ * @brief Erase the whole chip with all four chips (CE1-4) erasing concurrently
+ *
+ * Each chip walks its own part of the address space block by block: the
+ * pair below A27 up to END_ADDRESS_C or BIT27, the pair above A27 the rest,
+ * if there is any. Chips are polled round-robin and a new block erase is
+ * started as soon as a chip reports ready, so no chip idles while another
+ * one is still busy. A failed erase is blank checked and retried on the
+ * affected chip only. The chips are reset after a failed erase and on a
+ * timeout, and RST# is shared, so the other chips restart their block. A
+ * chip that timed out is also checked for lock-up by reading its ID.
+ *
+ * @return uint32_t 0 on success, bit 2 set on fatal error, bit 3 set on cancel
+ */
+static uint32_t CV_ChipErase(void) {
+  struct {
+    uint32_t addr;     /* block currently being erased */
+    uint32_t end;      /* end of this chip's part */
+    uint32_t endtime;  /* erase timeout */
+    int tries;
+    uint8_t busy;
+  } die[4];
+  uint16_t sr;
+  int pending = 0;
+
+  for(int i = 0; i < 4; i++) {
+    die[i].addr = (i & 2) ? BIT27 : 0;
+    die[i].end = (i & 2) ? END_ADDRESS_C : (END_ADDRESS_C < BIT27 ? END_ADDRESS_C : BIT27);
+    die[i].tries = 0;
+    die[i].busy = 0;
+    if(die[i].addr < die[i].end) pending |= 1 << i;
+  }
+
+  while(pending) {
+    for(int i = 0; i < 4; i++) {
+      uint8_t half = (i & 1) + 1;
+      if(!(pending & (1 << i))) continue;
+      if(!die[i].busy) {
+        CV_WriteCycle(half, die[i].addr, 0x50);
+        CV_WriteCycle(half, die[i].addr, 0x60);
+        CV_WriteCycle(half, die[i].addr, 0xd0);
+        CV_WaitStatus(NULL, half, die[i].addr, 0x80, 10);
+        CV_WriteCycle(half, die[i].addr, 0x20);
+        CV_WriteCycle(half, die[i].addr, 0xd0);
+        die[i].busy = 1;
+        die[i].endtime = ticks + 500;
+        STATUS_Post(STATUS_ERASE_CHIPS,
+                    ((die[2].addr & ~BIT27) / SECTOR_SIZE) << 16 | (die[3].addr & ~BIT27) / SECTOR_SIZE,
+                    (die[0].addr & ~BIT27) / SECTOR_SIZE, (die[1].addr & ~BIT27) / SECTOR_SIZE);
+        continue;
+      }
+      sr = CV_ReadStatus(half, die[i].addr);
+      if(!(sr & 0x80)) {
+        if(ticks <= die[i].endtime) continue;
+        /* timeout - RST# hits all chips, so every running erase is restarted */
+        CV_Reset();
+        for(int j = 0; j < 4; j++) {
+          die[j].busy = 0;
+        }
+        STATUS_Post(STATUS_ERASE_TIMEOUT, 0, 0, 0);
+        CV_SectorBlankCheck(half, die[i].addr);
+        if(flag_button & FLAG_BTN_BRD_LONG) {
+          flag_button &= ~(FLAG_BTN_BRD_LONG);
+          sr = 0x80; /* skip this block */
+        } else {
+          if(CV_CheckID(half, die[i].addr)) {
+            STATUS_Post(STATUS_ERASE_LOCKED, die[i].addr, half, 0);
+            return 4;
+          }
+          die[i].tries++;
+          continue;
+        }
+      }
+      die[i].busy = 0;
+      CV_WriteCycle(half, die[i].addr, 0x50);
+      if(sr != 0x80) {
+        STATUS_Post(STATUS_ERASE_RETRY, die[i].addr, half, ++die[i].tries);
+        CV_SectorBlankCheck(half, die[i].addr);
+        CV_Reset();
+        for(int j = 0; j < 4; j++) {
+          die[j].busy = 0;
+        }
+        continue;
+      }
+      die[i].tries = 0;
+      die[i].addr += SECTOR_SIZE;
+      if(die[i].addr >= die[i].end) {
+        pending &= ~(1 << i);
+      }
+    }
+    if(flag_button & (FLAG_BTN_BRD)) {
+      flag_button &= ~(FLAG_BTN_BRD);
+      CV_Reset();
+      return 8;
+    }
+  }
+  return 0;
+}
+
 void CV_Erase() {
   uint32_t starttime = ticks;
   LCD_Clear();
-  LCD_xyprintf(0, 0, 0, "Erasing Chip\n(aggressively)\n");
-  for(int i = 0; i < END_ADDRESS_C; i += SECTOR_SIZE) {
-    int res = CV_SectorErase(3, i);
-    if(res & 0xc) {
-      if(res & 0x8) {
-        LCD_printf(3, "Erase aborted on    \nuser request.     \n");
-      } else {
-        LCD_printf(1, "Error during erase\n");
-      }
-      goto erase_abort;
+  LCD_xyprintf(0, 0, 0, "Erasing Chip (4x)\n");
+  /* C and V chips share the adapter, either may be in the socket */
+  DLT_Forget(CHIP_C);
+  DLT_Forget(CHIP_V);
+  int res = CV_ChipErase();
+  LCD_xyprintf(0, 3, 0, "");
+  if(res & 0xc) {
+    if(res & 0x8) {
+      LCD_printf(3, "Erase aborted on    \nuser request.     \n");
+    } else {
+      LCD_printf(1, "Error during erase\n");
     }
+    goto erase_abort;
   }
   LCD_printf(2, "Erase complete!\nTime: %d s     \n", (ticks - starttime) / 100);
 erase_abort:
@@ -1322,189 +1582,342 @@ void CV_BlankCheck() {
   waitButton();
 }
 
-void CV_genScrambleLookup(chip_t chiptype) {
-  if(chiptype == CHIP_C) {
-    for(int i = 0; i < 65536; i++) {
-      scramble_lookup[i] = cv_scr_data(i);
-    }
+/* flags = MAN_FLAG_x of the image; a pre-scrambled image is used as it is */
+void CV_genScrambleLookup(chip_t chiptype, uint32_t flags) {
+  if(chiptype == CHIP_C && !(flags & MAN_FLAG_SCRAMBLED)) {
+    SCRAMBLE_Select(cv_scr_lo, cv_scr_hi);
     for(int i = 0; i < 512; i++) {
       addr_lookup[i] = (i & ~0xf) | ADDR_SCRTAB[i & 0xf];
     }
   } else {
-    for(int i = 0; i < 65536; i++) {
-      scramble_lookup[i] = i;
-    }
+    SCRAMBLE_Select(NULL, NULL);
     for(int i = 0; i < 512; i++) {
       addr_lookup[i] = i;
     }
   }
 }
 
-void CV_genDescrambleLookup(chip_t chiptype) {
-  if(chiptype == CHIP_C) {
-    for(int i = 0; i < 65536; i++) {
-      scramble_lookup[i] = cv_desc_data(i);
-    }
+void CV_genDescrambleLookup(chip_t chiptype, uint32_t flags) {
+  if(chiptype == CHIP_C && !(flags & MAN_FLAG_SCRAMBLED)) {
+    SCRAMBLE_Select(cv_desc_lo, cv_desc_hi);
     for(int i = 0; i < 512; i++) {
       addr_lookup[i] = (i & ~0xf) | ADDR_SCRTAB[i & 0xf];
     }
   } else {
-    for(int i = 0; i < 65536; i++) {
-      scramble_lookup[i] = i;
-    }
+    SCRAMBLE_Select(NULL, NULL);
     for(int i = 0; i < 512; i++) {
       addr_lookup[i] = i;
     }
   }
 }
 
-void CV_ScrambleBuffer(uint16_t *buffer, uint32_t length) {
-  for(int i = 0; i < length; i++) {
-    buffer[i] = scramble_lookup[buffer[i]];
-  }
-}
-
-void CV_Program_Internal(const char *filename, uint32_t address, chip_t chiptype) {
+void CV_Program_Internal(const char *filename, int resume, chip_t chiptype) {
   uint32_t addr;
   FIL file;
-  UINT bytes_read;
+  stream_t stream;
   uint32_t starttime = ticks;
   uint8_t erase_status = 0;
-  uint8_t fatal = 0, cancel = 0;
+  uint8_t fatal = 0, cancel = 0, ioerror = 0;
+  int delta = 0;
+  uint32_t flags;
   FRESULT res;
 
   LCD_Clear();
-  res = f_open(&file, filename, FA_READ);
+  res = STREAM_OpenImage(&stream, &file, filename, (FSIZE_t)END_ADDRESS_C * 4);
   if(check_fresult(res, "Could not open file:\n%s\n", filename)) {
     return;
   }
 
-  res = f_lseek(&file, address * 4);
-  if(check_fresult(res, "Seek to %lx failed\n", address * 4)) {
-    f_close(&file);
-    return;
-  };
+  flags = MAN_Flags(filename, SECTOR_SIZE * 4);
+  CV_genScrambleLookup(chiptype, flags);
+  PROF_Start();
 
-  CV_genScrambleLookup(chiptype);
+  res = JRN_Begin(filename, chiptype, END_ADDRESS_C / SECTOR_SIZE, resume);
+  if(res != FR_OK) {
+    LCD_xyprintf(0, 5, 1, "No journal: %s\n", get_fresult_name(res));
+  } else if(!resume) {
+    /* only the sectors changed since the last build, see delta.c */
+    delta = DLT_Offer(chiptype, filename, SECTOR_SIZE * 4, END_ADDRESS_C / SECTOR_SIZE);
+  }
+  DLT_Forget(chiptype);
 
-  for(addr = address; addr < END_ADDRESS_C; addr += SECTOR_SIZE) {
-    LCD_xyprintf(0, 0, 0, "Programming %3d%%\n", (int)((double)100.0 * (double)addr / (double)END_ADDRESS_C));
+  /* sectors the journal has as done are not touched again */
+  for(addr = JRN_Next(0) * SECTOR_SIZE; addr < END_ADDRESS_C; addr = JRN_Next(addr / SECTOR_SIZE + 1) * SECTOR_SIZE) {
+    STATUS_Post(STATUS_PROGRAMMING, 0, (int)((double)100.0 * (double)addr / (double)END_ADDRESS_C), 0);
     uint8_t erase = 3;
-    res = f_read(&file, buffer, SECTOR_SIZE * 4, &bytes_read);
-    check_fresult(res, "File read failed\n");
-    CV_ScrambleBuffer(buffer, SECTOR_SIZE * 2);
-    if(!bytes_read) break;
-    /* first, determine if we need to reprogram at all */
-    while((erase = CV_SectorVerify(3, addr, buffer))) {
-      do {
+    uint8_t program;
+    int check;
+    /* sector data is loaded in the background while the first verify
+       pass reads the chip */
+    res = STREAM_Start(&stream, buffer, (FSIZE_t)addr * 4, SECTOR_SIZE * 4);
+    if(res != FR_OK) {
+      ioerror = 1;
+      goto program_abort;
+    }
+    if(!stream.valid) break;
+    /* unused ROM space (all 0xff) only needs to be erased, which the chip's
+       blank check tells much faster than reading the sector back */
+    if(STREAM_IsBlank(&stream, SECTOR_SIZE * 4)) {
+      MAN_Record(addr / SECTOR_SIZE, CRC32_Buffer(buffer, SECTOR_SIZE * 4), 1);
+      erase = CV_SectorBlankCheck(3, addr);
+      while(erase) {
         erase_status = CV_SectorErase(erase, addr);
         fatal = erase_status & 4;
         cancel = erase_status & 8;
         if(fatal || cancel) goto program_abort;
-        CV_SectorBlankCheck(erase, addr);
-        erase = CV_SectorProgram(erase, addr, buffer);
+        erase = CV_SectorBlankCheck(erase, addr);
+      }
+      JRN_Done(addr / SECTOR_SIZE);
+      PROF_Sector(addr);
+      continue;
+    }
+    /* first, determine if we need to reprogram at all, and if so, whether
+       the halves can be programmed over their current contents */
+    PROF_Switch(PROF_BUS);
+    check = CV_SectorCheckForProgram(3, addr, buffer, &stream);
+    PROF_Switch(PROF_OTHER);
+    res = STREAM_Sync(&stream, SECTOR_SIZE * 4);
+    if(res != FR_OK) {
+      ioerror = 1;
+      goto program_abort;
+    }
+    MAN_Record(addr / SECTOR_SIZE, CRC32_Buffer(buffer, SECTOR_SIZE * 4), 0);
+    program = check & 3;
+    erase = check >> 2;
+    while(program) {
+      do {
         if(erase) {
-          LCD_xyprintf(0, 4, 1, "Retrying half %d     \n", erase);
+          erase_status = CV_SectorErase(erase, addr);
+          fatal = erase_status & 4;
+          cancel = erase_status & 8;
+          if(fatal || cancel) goto program_abort;
+          CV_SectorBlankCheck(erase, addr);
+        }
+        program = CV_SectorProgram(program, addr, buffer);
+        if(program) {
+          STATUS_Post(STATUS_PROGRAM_RETRY, 0, program, 0);
         } else {
-          LCD_xyprintf(0, 4, 2, "Happy Happy Happy :)\n");
+          STATUS_Post(STATUS_PROGRAM_OK, 0, 0, 0);
         }
-      } while (erase);
+        /* failed halves are retried from a fresh erase */
+        erase = program;
+      } while (program);
+      PROF_Switch(PROF_BUS);
+      program = CV_SectorCheckForProgram(3, addr, buffer, NULL) & 3;
+      PROF_Switch(PROF_OTHER);
+      erase = program;
     }
+    JRN_Done(addr / SECTOR_SIZE);
+    PROF_Sector(addr);
   }
   program_abort:
+  STREAM_Close(&stream);
   f_close(&file);
+  if(ioerror) {
+    LCD_Clear();
+    check_fresult(res, "File read failed\nAddress: %08lx\n", addr);
+  }
   if(fatal) {
     LCD_Clear();
     LCD_printf(1, "Fatal error!\nAddress: %08lx\n", addr);
-    if(saveProgress(addr, filename, chiptype) == FR_OK) {
+    if(JRN_Close() == FR_OK) {
       LCD_printf(0, "Progress has been\nsaved. Cycle power\nto continue.\n");
     }
-  } else if (cancel) {
+  } else if (cancel || ioerror) {
     LCD_Clear();
     LCD_printf(0, "Programming canceled\n");
-    LCD_printf(0, "on user request.\n");
+    LCD_printf(0, ioerror ? "on read error.\n" : "on user request.\n");
     LCD_printf(0, "Save progress to\n");
     LCD_printf(0, "continue later?\n");
-    if(waitYesNo()) {
-      if(saveProgress(addr, filename, chiptype) == FR_OK) {
-        LCD_printf(0, "Progress has been\nsaved.");
-      } else {
-        f_unlink(PROG_SAVE_FILE);
-      }
+    if(waitYesNo() && JRN_Close() == FR_OK) {
+      LCD_printf(0, "Progress has been\nsaved.");
+    } else {
+      JRN_Delete();
     }
   } else {
     LCD_xyprintf(0, 3, 2, "                    \rProgram complete!\n                    \rTime: %d s\n", (ticks - starttime) / 100);
-    f_unlink(PROG_SAVE_FILE);
+    JRN_Delete();
+    /* the whole image went through the buffer, so its manifest is known */
+    if(!resume && !delta) {
+      MAN_Save(filename, SECTOR_SIZE * 4, addr / SECTOR_SIZE, flags);
+    }
+    DLT_Programmed(chiptype, filename, SECTOR_SIZE * 4);
+    PROF_Save("prog", chiptype);
+    waitButton();
+    PROF_Summary();
   }
   waitButton();
 }
 
 void CV_Program(chip_t chiptype) {
-  FILINFO fno;
+  char image[STREAM_NAME_LEN];
 
   LCD_Clear();
-  choose_file(&fno, "/", FA_READ);
-  CV_Program_Internal(fno.fname, 0, chiptype);
+  choose_image(image, (FSIZE_t)END_ADDRESS_C * 4);
+  CV_Program_Internal(image, 0, chiptype);
+}
+
+/**
+ * @brief Verify against the image's manifest: each sector is read back like
+ *        a dump and its CRC compared, blank sectors get a blank check. The
+ *        image itself is not read.
+ *
+ * @return uint32_t number of bad sectors
+ */
+static uint32_t CV_VerifyManifest(manifest_t *man, chip_t chiptype) {
+  uint32_t error = 0;
+  uint32_t crc;
+  int blank, bad;
+
+  CV_genDescrambleLookup(chiptype, man->flags);
+  LCD_xyprintf(0, 3, 0, "Using %s\n", MAN_EXT);
+  for(int i = 0; i < END_ADDRESS_C; i += SECTOR_SIZE) {
+    STATUS_Post(STATUS_VERIFYING, 0, (int)((double)100.0*(double)i/(double)END_ADDRESS_C+0.5), 0);
+    blank = MAN_Next(man, &crc);
+    if(blank < 0) break;
+    PROF_Switch(PROF_BUS);
+    if(blank) {
+      bad = CV_SectorBlankCheck(3, i);
+    } else {
+      CV_SectorDump(i, buffer, SECTOR_SIZE);
+      PROF_Switch(PROF_OTHER);
+      bad = CRC32_Buffer(buffer, SECTOR_SIZE * 4) != crc;
+    }
+    PROF_Switch(PROF_OTHER);
+    if(bad) {
+      LCD_xyprintf(0, 2, 3, "VR %08lx bad\n", i);
+      error++;
+    }
+    PROF_Sector(i);
+  }
+  return error;
 }
 
 void CV_Verify(chip_t chiptype) {
   uint32_t error = 0;
-  UINT bytes_read;
 
-  FILINFO fno;
+  char image[STREAM_NAME_LEN];
   FIL file;
+  stream_t stream;
+  manifest_t man;
+  FRESULT res;
 
   uint32_t starttime = ticks;
 
   LCD_Clear();
-  choose_file(&fno, "/", FA_READ);
+  choose_image(image, (FSIZE_t)END_ADDRESS_C * 4);
   LCD_Clear();
-  CV_genScrambleLookup(chiptype);
-  f_open(&file, fno.fname, FA_READ);
+  PROF_Start();
+  res = MAN_Open(&man, image, SECTOR_SIZE * 4);
+  if(res == FR_OK) {
+    error = CV_VerifyManifest(&man, chiptype);
+    MAN_Close(&man);
+    goto verify_done;
+  }
+  if(res == FR_INVALID_OBJECT) {
+    LCD_xyprintf(0, 3, 1, "%s outdated\n", MAN_EXT);
+  }
+  CV_genScrambleLookup(chiptype, 0);
+  res = STREAM_OpenImage(&stream, &file, image, (FSIZE_t)END_ADDRESS_C * 4);
+  if(check_fresult(res, "Could not open file:\n%s\n", image)) {
+    return;
+  }
 
+  /* the sector is compared chunk by chunk while the rest of it is still
+     coming in from the card */
   for(int i = 0; i < END_ADDRESS_C; i += SECTOR_SIZE) {
-    LCD_xyprintf(0, 0, 0, "Verify %3d%%\n", (int)((double)100.0*(double)i/(double)END_ADDRESS_C+0.5));
-    f_read(&file, buffer, SECTOR_SIZE * 4, &bytes_read);
-    CV_ScrambleBuffer(buffer, SECTOR_SIZE * 2);
-    if(!bytes_read) break;
-    if(CV_SectorVerify(3, i, buffer)) {
+    STATUS_Post(STATUS_VERIFYING, 0, (int)((double)100.0*(double)i/(double)END_ADDRESS_C+0.5), 0);
+    res = STREAM_Start(&stream, buffer, (FSIZE_t)i * 4, SECTOR_SIZE * 4);
+    if(res != FR_OK || !stream.valid) break;
+    PROF_Switch(PROF_BUS);
+    if(CV_SectorVerify(3, i, buffer, &stream)) {
       error++;
     };
+    PROF_Switch(PROF_OTHER);
+    /* a mismatch ends the compare early, the load has to finish anyway */
+    res = STREAM_Sync(&stream, SECTOR_SIZE * 4);
+    if(res != FR_OK) break;
+    PROF_Sector(i);
   }
+  STREAM_Close(&stream);
   f_close(&file);
-  LCD_printf(error ? 1 : 2, "Verify done,        \n%d bad blocks.\nTime: %d\n", error, (ticks-starttime) / 100);
+  if(res != FR_OK) {
+    LCD_xyprintf(0, 4, 1, "Read error: %s\n", get_fresult_name(res));
+  }
+  verify_done:
+  PROF_Save("verify", chiptype);
+  LCD_xyprintf(0, 1, error ? 1 : 2, "Verify done,        \n%d bad blocks.\nTime: %d\n", error, (ticks-starttime) / 100);
+  waitButton();
+  PROF_Summary();
   waitButton();
 }
 
 void CV_Dump(chip_t chiptype) {
   FIL file;
   FRESULT res;
+  stream_t stream;
+  uint32_t crc;
 
   uint32_t starttime = ticks;
 
   LCD_Clear();
-  CV_genDescrambleLookup(chiptype);
+  CV_genDescrambleLookup(chiptype, 0);
+  PROF_Start();
 
   res = f_open(&file, DUMP_FILENAMES[chiptype], FA_CREATE_ALWAYS | FA_WRITE);
   if(check_fresult(res, "Could not open file\n%s\n", DUMP_FILENAMES[chiptype])) {
     return;
   }
+  res = STREAM_Create(&stream, &file, (FSIZE_t)END_ADDRESS_C * 4);
+  if(check_fresult(res, "Could not allocate\n%s\n", DUMP_FILENAMES[chiptype])) {
+    f_close(&file);
+    return;
+  }
 
+  /* The buffer is processed in chunks: while a chunk is written to the card
+     by DMA, the next one is read from the chip. */
   LCD_xyprintf(0, 2, 0, "-> %s\n", DUMP_FILENAMES[chiptype]);
   for(int i = 0; i < END_ADDRESS_C; i += SECTOR_SIZE) {
-    LCD_xyprintf(0, 0, 0, "Dumping %3d%%\n", (int)((double)100.0*(double)i/(double)END_ADDRESS_C+0.5));
-    CV_SectorDump(i, buffer);
-    CV_ScrambleBuffer(buffer, SECTOR_SIZE * 2);
-    res = f_write(&file, buffer, SECTOR_SIZE * 4, NULL);
-    if(check_fresult(res, "File write error\n")) {
-      f_close(&file);
-      return;
+    STATUS_Post(STATUS_DUMPING, 0, (int)((double)100.0*(double)i/(double)END_ADDRESS_C+0.5), 0);
+    CRC32_Start();
+    for(int j = 0; j < SECTOR_SIZE; j += STREAM_DUMP_CHUNK / 4) {
+      uint16_t *chunk = buffer + j * 2;
+      PROF_Switch(PROF_BUS);
+      CV_SectorDump(i + j, chunk, STREAM_DUMP_CHUNK / 4);
+      PROF_Switch(PROF_OTHER);
+      CRC32_Update(chunk, STREAM_DUMP_CHUNK);
+      res = STREAM_Sync(&stream, STREAM_DUMP_CHUNK);
+      if(res == FR_OK) {
+        res = STREAM_Write(&stream, chunk, (FSIZE_t)(i + j) * 4, STREAM_DUMP_CHUNK);
+      }
+      if(res != FR_OK) {
+        STREAM_Close(&stream);
+        f_close(&file);
+        check_fresult(res, "File write error\n");
+        return;
+      }
     }
+    MAN_Record(i / SECTOR_SIZE, CRC32_Value(), 0);
+    PROF_Sector(i);
   }
+  res = STREAM_Sync(&stream, STREAM_DUMP_CHUNK);
+  STREAM_Close(&stream);
   f_close(&file);
-  LCD_printf(2, "Dump finished!      \n");
+  if(check_fresult(res, "File write error\n")) {
+    return;
+  }
+  res = HASH_Save(chiptype, SECTOR_SIZE * 4, END_ADDRESS_C / SECTOR_SIZE, &crc);
+  PROF_Save("dump", chiptype);
+  LCD_xyprintf(0, 1, 2, "Dump finished!      \n");
+  if(res == FR_OK) {
+    LCD_printf(2, "CRC32 %08lx       \n", (unsigned long)crc);
+  } else {
+    LCD_printf(1, "No .crc: %s\n", get_fresult_name(res));
+  }
   LCD_printf(2, "Time: %d s        \n", (ticks - starttime) / 100);
   waitButton();
+  PROF_Summary();
+  waitButton();
 }
 
 void CV_ReadTest() {
@@ -5,6 +5,10 @@
 // 55LV100S
 #define SECTOR_SIZE 0x20000
 #define REGION_SIZE 0x20 // in words
+#define PAGE_SIZE   8    // in words, page read
+
+/* sector buffer halves, used alternately */
+#define P_SECTOR_BUF(half) (buffer + (half) * SECTOR_SIZE)
 
 
 /*
@@ -37,6 +41,16 @@
  *  RST#   -> Tied high on adapter
  *
  *
+ * Page read:
+ * ==========
+ *
+ * The chips have a 16 byte page buffer. Once a page has been accessed,
+ * other locations in the same page can be read with the page access time
+ * (25ns) instead of the random access time (110ns) while CE#/OE# stay low.
+ * Only 8 words (A2:0) are read per page, which is within the page whether
+ * A0 is the chip's A-1 (byte mode) or A0 (word mode).
+ *
+ *
  * Pin mapping conflicts with on-board hardware:
  * =============================================
  * Signal  Pin   shared with
@@ -147,54 +161,6 @@ static const int ctrl_capa_thres[1][3] = {
   }
 };
 
-static uint32_t p_desc_data(uint32_t dat) // china pinout descramble
-{
-  uint32_t data = 0;
-
-  if (dat & BIT0)  data |= BIT8;
-  if (dat & BIT1)  data |= BIT10;
-  if (dat & BIT2)  data |= BIT12;
-  if (dat & BIT3)  data |= BIT14;
-  if (dat & BIT4)  data |= BIT7;
-  if (dat & BIT5)  data |= BIT5;
-  if (dat & BIT6)  data |= BIT3;
-  if (dat & BIT7)  data |= BIT1;
-  if (dat & BIT8)  data |= BIT9;
-  if (dat & BIT9)  data |= BIT11;
-  if (dat & BIT10) data |= BIT13;
-  if (dat & BIT11) data |= BIT15;
-  if (dat & BIT12) data |= BIT6;
-  if (dat & BIT13) data |= BIT4;
-  if (dat & BIT14) data |= BIT2;
-  if (dat & BIT15) data |= BIT0;
-
-  return data;
-}
-
-static uint32_t p_scr_data(uint32_t dat) // china pinout descramble
-{
-  uint32_t data = 0;
-
-  if (dat & BIT0)  data |= BIT15;
-  if (dat & BIT1)  data |= BIT7;
-  if (dat & BIT2)  data |= BIT14;
-  if (dat & BIT3)  data |= BIT6;
-  if (dat & BIT4)  data |= BIT13;
-  if (dat & BIT5)  data |= BIT5;
-  if (dat & BIT6)  data |= BIT12;
-  if (dat & BIT7)  data |= BIT4;
-  if (dat & BIT8)  data |= BIT0;
-  if (dat & BIT9)  data |= BIT8;
-  if (dat & BIT10) data |= BIT1;
-  if (dat & BIT11) data |= BIT9;
-  if (dat & BIT12) data |= BIT2;
-  if (dat & BIT13) data |= BIT10;
-  if (dat & BIT14) data |= BIT3;
-  if (dat & BIT15) data |= BIT11;
-
-  return data;
-}
-
 static inline void P_nCE(uint32_t st)
 {
   GPIOD -> BSRR = (BIT0 << 16) | ((st & 1) << 0);
@@ -295,6 +261,29 @@ uint32_t P_ReadCycle(uint32_t addr)
   return data;
 }
 
+/**
+ * Read consecutive words within one page. The first word takes the random
+ * access time, the others only change A2:0 and use the page access time.
+ * @param addr first word
+ * @param data destination
+ * @param count number of words, addr+count must not cross a PAGE_SIZE boundary
+ */
+static void P_ReadPage(uint32_t addr, uint16_t *data, uint32_t count)
+{
+  P_SetAddress(addr);
+  P_nCE(0);
+  P_nOE(0);
+  Delay_cycles(64); // ~133ns
+  data[0] = P_GetData();
+  for(int i = 1; i < count; i++) {
+    GPIOB -> BSRR = (0x7 << 16) | ((addr + i) & 0x7);
+    Delay_cycles(16); // ~33ns
+    data[i] = P_GetData();
+  }
+  P_nOE(1);
+  P_nCE(1);
+}
+
 void P_WriteCycle(uint32_t addr, uint16_t data)
 {
   P_SetAddress(addr);
@@ -339,6 +328,7 @@ int P_WaitStatus(uint16_t *status, uint32_t addr, uint16_t mask, int timeout) {
   int result = 0;
   uint16_t data = 0xffff;
   uint32_t endtime = ticks + timeout;
+  prof_counter_t prof = PROF_Poll();
 
   do {
     /* speed up data line pull-down in case chip has gone High-Z
@@ -362,6 +352,7 @@ int P_WaitStatus(uint16_t *status, uint32_t addr, uint16_t mask, int timeout) {
     result = 1;
   }
 
+  PROF_Switch(prof);
   return result;
 }
 
@@ -399,19 +390,22 @@ uint32_t P_SectorErase(uint32_t addr)
 {
   uint16_t sr;
   uint32_t res = 0;
+  prof_counter_t prof;
 
   int try = 0;
   int dirty = 1;
   P_WriteCycle(addr, 0xf0f0);
   do {
-    LCD_xyprintf(0, 1, 0, "ER %08lx [%d]\n", addr, try++);
+    STATUS_Post(STATUS_ERASE_P, addr, try++, 0);
     P_WriteUnlockSequence();
     P_WriteCycle(0xaaa, 0x8080);
     P_WriteUnlockSequence();
     P_WriteCycle(addr, 0x3030);
+    prof = PROF_Switch(PROF_ERASE);
     res = P_WaitStatus(&sr, addr, 0x8080, 400);
+    PROF_Switch(prof);
     if(res) {
-      LCD_printf(0, "ER Timeout          \n");
+      LCD_xyprintf(0, 2, 0, "ER Timeout          \n");
       if(flag_button & FLAG_BTN_BRD_LONG) {
         flag_button &= ~(FLAG_BTN_BRD_LONG);
         break;
@@ -426,7 +420,7 @@ uint32_t P_SectorErase(uint32_t addr)
     }
     if((sr & 0x8080) == 0x8080) dirty = 0;
     if(dirty) {
-      LCD_xyprintf(0, 2, 1, "ER sr=%04x\n", sr);
+      STATUS_Post(STATUS_ERASE_SR_P, 0, sr, 0);
     }
     if(flag_button & (FLAG_BTN_BRD)) {
       flag_button &= ~(FLAG_BTN_BRD);
@@ -445,24 +439,35 @@ abort:
  *
  * @param addr
  * @param buffer
+ * @param stream if not NULL, buffer is still being loaded by this stream;
+ *               wait for each chunk before comparing against it
  * @return int
  */
-int P_SectorCheckForProgram(uint32_t addr, uint16_t *buffer) {
+int P_SectorCheckForProgram(uint32_t addr, uint16_t *buffer, stream_t *stream) {
+  uint16_t page[PAGE_SIZE];
   uint16_t data, compare;
   int need_program = 0;
   int need_erase = 0;
   P_WriteCycle(addr, 0xf0f0);
-  LCD_xyprintf(0, 1, 0, "VR %08lx         \r", addr);
-  for(int j = 0; j < SECTOR_SIZE; j++) {
-    data = P_ReadCycle(addr+j);
-    compare = buffer[j];
-    if(data != compare) {
-      if(!need_program) {
-        LCD_xyprintf(0, 2, 3, "VR %04x != %04x\r", data, compare);
+  STATUS_Post(STATUS_VERIFY_P, addr, 0, 0);
+  for(int j = 0; j < SECTOR_SIZE; j += PAGE_SIZE) {
+    if(stream && !(j & (STREAM_CHUNK / 2 - 1))) {
+      if(STREAM_Sync(stream, (j * 2) + STREAM_CHUNK) != FR_OK) {
+        return 3;
       }
-      need_program = 1;
-      if((data | compare) != data) {
-        need_erase = 1;
+    }
+    P_ReadPage(addr+j, page, PAGE_SIZE);
+    for(int k = 0; k < PAGE_SIZE; k++) {
+      data = page[k];
+      compare = SCRAMBLE_Word(buffer[j+k]);
+      if(data != compare) {
+        if(!need_program) {
+          STATUS_Post(STATUS_VERIFY_DIFF, 0, data, compare);
+        }
+        need_program = 1;
+        if((data | compare) != data) {
+          need_erase = 1;
+        }
       }
     }
     if(need_erase) break;
@@ -471,24 +476,67 @@ int P_SectorCheckForProgram(uint32_t addr, uint16_t *buffer) {
 }
 
 
-int P_SectorVerify(uint32_t addr, uint16_t *buffer) {
+/**
+ * @brief Compare a sector against the buffer contents
+ *
+ * @param addr sector address
+ * @param buffer sector buffer
+ * @param stream if not NULL, buffer is still being loaded by this stream;
+ *               wait for each chunk before comparing against it
+ * @return int 1 on mismatch
+ */
+int P_SectorVerify(uint32_t addr, uint16_t *buffer, stream_t *stream) {
+  uint16_t page[PAGE_SIZE];
   uint16_t data, compare;
   int dirty = 0;
 
   P_WriteCycle(addr, 0xf0f0);
-  LCD_xyprintf(0, 1, 0, "VR %08lx         \r", addr);
-  for(int j = 0; j < SECTOR_SIZE; j++) {
-    data = P_ReadCycle(addr+j);
-    compare = buffer[j];
-    if(data != compare) {
-      LCD_xyprintf(0, 2, 3, "VR %04x != %04x\r", data, compare);
-      dirty |= 1;
+  STATUS_Post(STATUS_VERIFY_P, addr, 0, 0);
+  for(int j = 0; j < SECTOR_SIZE && !dirty; j += PAGE_SIZE) {
+    if(stream && !(j & (STREAM_CHUNK / 2 - 1))) {
+      if(STREAM_Sync(stream, (j * 2) + STREAM_CHUNK) != FR_OK) {
+        return 1;
+      }
+    }
+    P_ReadPage(addr+j, page, PAGE_SIZE);
+    for(int k = 0; k < PAGE_SIZE; k++) {
+      data = page[k];
+      compare = SCRAMBLE_Word(buffer[j+k]);
+      if(data != compare) {
+        STATUS_Post(STATUS_VERIFY_DIFF, 0, data, compare);
+        dirty |= 1;
+        break;
+      }
     }
-    if(dirty) break;
   }
   return dirty;
 }
 
+/**
+ * @brief Check whether a sector is erased. Unlike the MT28, the S29GL has no
+ *        blank check command, so the sector is read in page mode, stopping
+ *        at the first programmed word.
+ *
+ * @param addr sector address
+ * @return int 2 (need erase, as P_SectorCheckForProgram) or 0 if blank
+ */
+int P_SectorBlankCheck(uint32_t addr) {
+  uint16_t page[PAGE_SIZE];
+
+  P_WriteCycle(addr, 0xf0f0);
+  STATUS_Post(STATUS_BLANK, addr, 0, 0);
+  for(int j = 0; j < SECTOR_SIZE; j += PAGE_SIZE) {
+    P_ReadPage(addr+j, page, PAGE_SIZE);
+    for(int k = 0; k < PAGE_SIZE; k++) {
+      if(page[k] != 0xffff) {
+        STATUS_Post(STATUS_BLANK_DIFF, addr+j+k, page[k], 0);
+        return 2;
+      }
+    }
+  }
+  return 0;
+}
+
 void P_TestAllPins(uint16_t data_mask, uint32_t addr_mask, uint16_t ctrl_mask, char *probename, char *probepin) {
   uint16_t test_data = (GPIOA->IDR & 0xff) | ((GPIOC->IDR & 0xff) << 8);
   uint32_t test_addr = GPIOB->IDR | ((GPIOE->IDR & 0x3ff) << 16);
@@ -558,6 +606,8 @@ void P_GetLineCapacitances(int *addr, int *data, int *ctrl) {
   SysTick->CTRL &= ~(SysTick_CTRL_ENABLE_Msk);
   NVIC_DisableIRQ(TIM1_UP_IRQn);
   NVIC_DisableIRQ(OTG_FS_WKUP_IRQn);
+  NVIC_DisableIRQ(SPI4_IRQn);
+  NVIC_DisableIRQ(DMA1_Stream0_IRQn);
   NVIC_ClearPendingIRQ(TIM1_UP_IRQn);
   NVIC_ClearPendingIRQ(OTG_FS_WKUP_IRQn);
 
@@ -663,6 +713,8 @@ void P_GetLineCapacitances(int *addr, int *data, int *ctrl) {
   __DSB(); __DMB(); __ISB();
   NVIC_EnableIRQ(TIM1_UP_IRQn);
   NVIC_EnableIRQ(OTG_FS_WKUP_IRQn);
+  NVIC_EnableIRQ(SPI4_IRQn);
+  NVIC_EnableIRQ(DMA1_Stream0_IRQn);
   SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
 
   /* revert to normal GPIO operation */
@@ -1019,6 +1071,7 @@ void P_Erase() {
   P_Init();
   LCD_Clear();
   LCD_xyprintf(0, 0, 0, "Erasing Chip\n");
+  DLT_Forget(CHIP_P);
   for(int i = 0; i < END_ADDRESS_P; i += SECTOR_SIZE) {
     P_WriteUnlockSequence();
     P_SectorErase(i);
@@ -1044,11 +1097,12 @@ int P_SectorProgram(uint32_t addr, uint16_t *buf) {
   uint16_t sr;
   uint16_t data;
   uint32_t addr_final;
+  prof_counter_t prof;
 
   P_WriteCycle(addr, 0xf0f0);
 
   int active = 1;
-  LCD_xyprintf(0, 1, 0, "PG %08lx\n", addr);
+  STATUS_Post(STATUS_PROGRAM_P, addr, 0, 0);
   for(int j = 0; j < SECTOR_SIZE; j += REGION_SIZE) {
     P_WriteUnlockSequence();
     P_WriteCycle(addr+j, 0x2525);
@@ -1056,13 +1110,15 @@ int P_SectorProgram(uint32_t addr, uint16_t *buf) {
     for(int d = 0; d < REGION_SIZE; d++) {
       addr_final = addr + j + d;
 
-      data = buf[(j+d)];
+      data = SCRAMBLE_Word(buf[(j+d)]);
       P_WriteCycle(addr_final, data);
     }
     P_WriteCycle(addr+j, 0x2929);
+    prof = PROF_Switch(PROF_PROGRAM);
     P_WaitStatus(&sr, addr+j+REGION_SIZE-1, data, 100);
+    PROF_Switch(prof);
     if((sr & 0x8080) != (data & 0x8080)) {
-      LCD_xyprintf(0, 2, 1, "PG sr=%04x\n", sr);
+      STATUS_Post(STATUS_PROGRAM_SR_P, 0, sr, 0);
       active = 0;
     }
     P_WriteCycle(addr+j, 0xf0f0);
@@ -1070,71 +1126,183 @@ int P_SectorProgram(uint32_t addr, uint16_t *buf) {
       break;
     }
   }
-  if(active)LCD_xyprintf(0, 2, 0, "                    \n");
+  if(active) STATUS_Post(STATUS_CLEAR, 0, 0, 0);
   return (~active) & 1;
 }
 
-void P_SectorDump(uint32_t addr, uint16_t *buffer) {
-  uint16_t data;
-  P_WriteCycle(addr, 0xf0f0);
-  LCD_xyprintf(0, 1, 0, "DP %08lx         \r", addr);
-  for(int j = 0; j < SECTOR_SIZE; j++) {
-    data = P_ReadCycle(addr+j);
-    buffer[j] = data;
+#ifdef BUS_DMA_READ
+/* Descramble a finished burst from the staging buffers into the buffer */
+static void P_MergeBurst(uint16_t *buffer, int slot) {
+  const uint8_t *lo = busdma_lo[slot];
+  const uint8_t *hi = busdma_hi[slot];
+  const uint16_t *scr_lo = scramble_lo;
+  const uint16_t *scr_hi = scramble_hi;
+
+  if(scr_lo) {
+    for(int k = 0; k < BUSDMA_BURST; k++) {
+      buffer[k] = scr_lo[lo[k]] | scr_hi[hi[k]];
+    }
+  } else {
+    for(int k = 0; k < BUSDMA_BURST; k++) {
+      buffer[k] = lo[k] | (hi[k] << 8);
+    }
   }
 }
 
-void P_genScrambleLookup(void) {
-  for(int i = 0; i < 65536; i++) {
-    scramble_lookup[i] = p_scr_data(i);
+/**
+ * Timer/DMA paced read of a block. The previous burst is copied into the
+ * buffer while the next one is running.
+ * @return 0 = OK, 1 = DMA error
+ */
+static int P_SectorDumpDMA(uint32_t addr, uint16_t *buffer, uint32_t count) {
+  uint16_t *pbuf = NULL;
+  int slot, pslot = 0;
+
+  P_SetAddress(addr);
+  P_nCE(0);
+  P_nOE(0);
+  for(uint32_t j = 0; j < count; j += BUSDMA_BURST) {
+    P_SetAddress(addr + j);
+    slot = BUSDMA_Start(BUSDMA_BURST);
+    if(slot >= 0 && pbuf) {
+      P_MergeBurst(pbuf, pslot);
+    }
+    if(slot < 0 || BUSDMA_Wait()) {
+      P_nOE(1);
+      P_nCE(1);
+      return 1;
+    }
+    pbuf = buffer + j;
+    pslot = slot;
+  }
+  P_nOE(1);
+  P_nCE(1);
+  if(pbuf) {
+    P_MergeBurst(pbuf, pslot);
   }
+  return 0;
 }
+#endif
 
-void P_genDescrambleLookup(void) {
-  for(int i = 0; i < 65536; i++) {
-    scramble_lookup[i] = p_desc_data(i);
+/**
+ * @brief Read a block of words from the chip into the buffer
+ *
+ * @param addr start address
+ * @param buffer destination buffer
+ * @param count number of words to read
+ */
+void P_SectorDump(uint32_t addr, uint16_t *buffer, uint32_t count) {
+  uint32_t n;
+  P_WriteCycle(addr, 0xf0f0);
+  STATUS_Post(STATUS_DUMP, addr, 0, 0);
+#ifdef BUS_DMA_READ
+  if(!(addr % BUSDMA_BURST) && !(count % BUSDMA_BURST)) {
+    if(!P_SectorDumpDMA(addr, buffer, count)) {
+      return;
+    }
+    /* fall back to CPU read cycles */
+    STATUS_Post(STATUS_DUMP_DMA, addr, 0, 0);
+  }
+#endif
+  for(uint32_t j = 0; j < count; j += n) {
+    n = PAGE_SIZE - ((addr + j) & (PAGE_SIZE - 1));
+    if(n > count - j) n = count - j;
+    P_ReadPage(addr+j, buffer+j, n);
+    for(uint32_t k = j; k < j + n; k++) {
+      buffer[k] = SCRAMBLE_Word(buffer[k]);
+    }
   }
 }
 
-void P_ScrambleBuffer(uint16_t *buffer, uint32_t length) {
-  for(int i = 0; i < length; i++) {
-    buffer[i] = scramble_lookup[buffer[i]];
+/* flags = MAN_FLAG_x of the image; a pre-scrambled image is used as it is */
+void P_genScrambleLookup(uint32_t flags) {
+  if(flags & MAN_FLAG_SCRAMBLED) {
+    SCRAMBLE_Select(NULL, NULL);
+  } else {
+    SCRAMBLE_Select(p_scr_lo, p_scr_hi);
   }
 }
 
-void P_Program_Internal(const char *filename, uint32_t address) {
-  uint32_t addr;
+void P_genDescrambleLookup(uint32_t flags) {
+  if(flags & MAN_FLAG_SCRAMBLED) {
+    SCRAMBLE_Select(NULL, NULL);
+  } else {
+    SCRAMBLE_Select(p_desc_lo, p_desc_hi);
+  }
+}
+
+void P_Program_Internal(const char *filename, int resume) {
+  uint32_t addr, next;
+  uint8_t half = 0;
   FIL file;
-  UINT bytes_read;
+  stream_t stream;
+  uint16_t *buf;
   uint32_t starttime = ticks;
   uint8_t erase_status = 0;
-  uint8_t fatal = 0, cancel = 0;
+  uint8_t fatal = 0, cancel = 0, ioerror = 0;
+  int delta = 0;
+  uint32_t flags;
   FRESULT res;
 
   P_Init();
 
   LCD_Clear();
-  res = f_open(&file, filename, FA_READ);
+  res = STREAM_OpenImage(&stream, &file, filename, (FSIZE_t)END_ADDRESS_P * 2);
   if(check_fresult(res, "Could not open file:\n%s\n", filename)) {
     return;
   }
 
-  res = f_lseek(&file, address * 2);
-  if(check_fresult(res, "Seek to %lx failed\n", address * 2)) {
-    return;
-  };
+  flags = MAN_Flags(filename, SECTOR_SIZE * 2);
+  P_genScrambleLookup(flags);
+  PROF_Start();
 
-  P_genScrambleLookup();
+  res = JRN_Begin(filename, CHIP_P, END_ADDRESS_P / SECTOR_SIZE, resume);
+  if(res != FR_OK) {
+    LCD_xyprintf(0, 5, 1, "No journal: %s\n", get_fresult_name(res));
+  } else if(!resume) {
+    /* only the sectors changed since the last build, see delta.c */
+    delta = DLT_Offer(CHIP_P, filename, SECTOR_SIZE * 2, END_ADDRESS_P / SECTOR_SIZE);
+  }
+  DLT_Forget(CHIP_P);
+
+  /* A P-ROM sector takes up half of the buffer, so the next sector is
+     loaded into the other half while the current one is being programmed.
+     Sectors the journal has as done are not touched again. */
+  addr = JRN_Next(0) * SECTOR_SIZE;
+  res = FR_OK;
+  if(addr < END_ADDRESS_P) {
+    res = STREAM_Start(&stream, P_SECTOR_BUF(half), (FSIZE_t)addr * 2, SECTOR_SIZE * 2);
+  }
+  if(res != FR_OK) {
+    ioerror = 1;
+    goto program_abort;
+  }
 
-  for(addr = address; addr < END_ADDRESS_P; addr += SECTOR_SIZE) {
-    LCD_xyprintf(0, 0, 0, "Programming %3d%%\n", (int)((double)100.0 * (double)addr / (double)END_ADDRESS_P + 0.25));
+  for(; addr < END_ADDRESS_P; addr = next, half ^= 1) {
+    STATUS_Post(STATUS_PROGRAMMING, 0, (int)((double)100.0 * (double)addr / (double)END_ADDRESS_P + 0.25), 0);
     uint8_t erase = 1;
-    res = f_read(&file, buffer, SECTOR_SIZE * 2, &bytes_read);
-    check_fresult(res, "File read failed\n");
-    P_ScrambleBuffer(buffer, SECTOR_SIZE);
-    if(!bytes_read) break;
+    uint8_t blank;
+    buf = P_SECTOR_BUF(half);
+    next = JRN_Next(addr / SECTOR_SIZE + 1) * SECTOR_SIZE;
+    if(!stream.valid) break;
+    /* unused ROM space (all 0xff) is only erased, never programmed */
+    blank = STREAM_IsBlank(&stream, SECTOR_SIZE * 2);
     /* first, determine if we need to reprogram at all */
-    while((erase = P_SectorCheckForProgram(addr, buffer))) {
+    PROF_Switch(PROF_BUS);
+    erase = blank ? P_SectorBlankCheck(addr) : P_SectorCheckForProgram(addr, buf, &stream);
+    PROF_Switch(PROF_OTHER);
+    res = STREAM_Sync(&stream, SECTOR_SIZE * 2);
+    if(res == FR_OK) {
+      MAN_Record(addr / SECTOR_SIZE, CRC32_Buffer(buf, SECTOR_SIZE * 2), blank);
+    }
+    if(res == FR_OK && next < END_ADDRESS_P) {
+      res = STREAM_Start(&stream, P_SECTOR_BUF(half ^ 1), (FSIZE_t)next * 2, SECTOR_SIZE * 2);
+    }
+    if(res != FR_OK) {
+      ioerror = 1;
+      goto program_abort;
+    }
+    while(erase) {
       do {
         if(erase & 2) { // need erase
           erase_status = P_SectorErase(addr);
@@ -1144,113 +1312,236 @@ void P_Program_Internal(const char *filename, uint32_t address) {
         fatal = erase_status & 4;
         cancel = erase_status & 8;
         if(fatal || cancel) goto program_abort;
-        erase = P_SectorProgram(addr, buffer);
+        if(blank) break;
+        PROF_Switch(PROF_BUS);
+        erase = P_SectorProgram(addr, buf);
+        PROF_Switch(PROF_OTHER);
         if(erase) {
           LCD_xyprintf(0, 4, 1, "Retrying ...         \n");
         } else {
           LCD_xyprintf(0, 4, 2, "Happy Happy Happy :)\n");
         }
       } while (erase);
+      PROF_Switch(PROF_BUS);
+      erase = blank ? P_SectorBlankCheck(addr) : P_SectorCheckForProgram(addr, buf, NULL);
+      PROF_Switch(PROF_OTHER);
     }
+    JRN_Done(addr / SECTOR_SIZE);
+    PROF_Sector(addr);
   }
   program_abort:
+  STREAM_Close(&stream);
   f_close(&file);
+  if(ioerror) {
+    LCD_Clear();
+    check_fresult(res, "File read failed\nAddress: %08lx\n", addr);
+  }
   if(fatal) {
     LCD_Clear();
     LCD_printf(1, "Fatal error!\nAddress: %08lx\n", addr);
-    if(saveProgress(addr, filename, CHIP_P) == FR_OK) {
+    if(JRN_Close() == FR_OK) {
       LCD_printf(0, "Progress has been\nsaved. Cycle power\nto continue.\n");
     }
-  } else if (cancel) {
+  } else if (cancel || ioerror) {
     LCD_Clear();
     LCD_printf(0, "Programming canceled\n");
-    LCD_printf(0, "on user request.\n");
+    LCD_printf(0, ioerror ? "on read error.\n" : "on user request.\n");
     LCD_printf(0, "Save progress to\n");
     LCD_printf(0, "continue later?\n");
-    if(waitYesNo()) {
-      if(saveProgress(addr, filename, CHIP_P) == FR_OK) {
-        LCD_printf(0, "Progress has been\nsaved.");
-      } else {
-        f_unlink(PROG_SAVE_FILE);
-      }
+    if(waitYesNo() && JRN_Close() == FR_OK) {
+      LCD_printf(0, "Progress has been\nsaved.");
+    } else {
+      JRN_Delete();
     }
   } else {
     LCD_xyprintf(0, 3, 2, "                    \rProgram complete!\n                    \rTime: %d s\n", (ticks - starttime) / 100);
-    f_unlink(PROG_SAVE_FILE);
+    JRN_Delete();
+    /* the whole image went through the buffer, so its manifest is known */
+    if(!resume && !delta) {
+      MAN_Save(filename, SECTOR_SIZE * 2, addr / SECTOR_SIZE, flags);
+    }
+    DLT_Programmed(CHIP_P, filename, SECTOR_SIZE * 2);
+    PROF_Save("prog", CHIP_P);
+    waitButton();
+    PROF_Summary();
   }
   waitButton();
 }
 
 void P_Program() {
-  FILINFO fno;
+  char image[STREAM_NAME_LEN];
 
   P_Init();
 
   LCD_Clear();
-  choose_file(&fno, "/", FA_READ);
-  P_Program_Internal(fno.fname, 0);
+  choose_image(image, (FSIZE_t)END_ADDRESS_P * 2);
+  P_Program_Internal(image, 0);
+}
+
+/**
+ * @brief Verify against the image's manifest: each sector is read back like
+ *        a dump and its CRC compared, blank sectors are checked for 0xffff.
+ *        The image itself is not read.
+ *
+ * @return uint32_t number of bad sectors
+ */
+static uint32_t P_VerifyManifest(manifest_t *man) {
+  uint32_t error = 0;
+  uint32_t crc;
+  int blank, bad;
+
+  P_genDescrambleLookup(man->flags);
+  LCD_xyprintf(0, 3, 0, "Using %s\n", MAN_EXT);
+  for(int i = 0; i < END_ADDRESS_P; i += SECTOR_SIZE) {
+    STATUS_Post(STATUS_VERIFYING, 0, (int)((double)100.0*(double)i/(double)END_ADDRESS_P+0.5), 0);
+    blank = MAN_Next(man, &crc);
+    if(blank < 0) break;
+    PROF_Switch(PROF_BUS);
+    if(blank) {
+      bad = P_SectorBlankCheck(i);
+    } else {
+      P_SectorDump(i, buffer, SECTOR_SIZE);
+      PROF_Switch(PROF_OTHER);
+      bad = CRC32_Buffer(buffer, SECTOR_SIZE * 2) != crc;
+    }
+    PROF_Switch(PROF_OTHER);
+    if(bad) {
+      LCD_xyprintf(0, 2, 3, "VR %08lx bad\n", i);
+      error++;
+    }
+    PROF_Sector(i);
+  }
+  return error;
 }
 
 void P_Verify() {
   uint32_t error = 0;
-  UINT bytes_read;
 
-  FILINFO fno;
+  char image[STREAM_NAME_LEN];
   FIL file;
+  stream_t stream;
+  manifest_t man;
+  FRESULT res;
 
   uint32_t starttime = ticks;
 
   P_Init();
 
   LCD_Clear();
-  choose_file(&fno, "/", FA_READ);
+  choose_image(image, (FSIZE_t)END_ADDRESS_P * 2);
   LCD_Clear();
-  P_genScrambleLookup();
-  f_open(&file, fno.fname, FA_READ);
+  PROF_Start();
+  res = MAN_Open(&man, image, SECTOR_SIZE * 2);
+  if(res == FR_OK) {
+    error = P_VerifyManifest(&man);
+    MAN_Close(&man);
+    goto verify_done;
+  }
+  if(res == FR_INVALID_OBJECT) {
+    LCD_xyprintf(0, 3, 1, "%s outdated\n", MAN_EXT);
+  }
+  P_genScrambleLookup(0);
+  res = STREAM_OpenImage(&stream, &file, image, (FSIZE_t)END_ADDRESS_P * 2);
+  if(check_fresult(res, "Could not open file:\n%s\n", image)) {
+    return;
+  }
 
+  /* the sector is compared chunk by chunk while the rest of it is still
+     coming in from the card */
   for(int i = 0; i < END_ADDRESS_P; i += SECTOR_SIZE) {
-    LCD_xyprintf(0, 0, 0, "Verify %3d%%\n", (int)((double)100.0*(double)i/(double)END_ADDRESS_P+0.5), i);
+    STATUS_Post(STATUS_VERIFYING, 0, (int)((double)100.0*(double)i/(double)END_ADDRESS_P+0.5), 0);
     P_WriteCycle(i, 0xf0);
-    f_read(&file, buffer, SECTOR_SIZE * 2, &bytes_read);
-    P_ScrambleBuffer(buffer, SECTOR_SIZE);
-    if(!bytes_read) break;
-    if(P_SectorVerify(i, buffer)) {
+    res = STREAM_Start(&stream, buffer, (FSIZE_t)i * 2, SECTOR_SIZE * 2);
+    if(res != FR_OK || !stream.valid) break;
+    PROF_Switch(PROF_BUS);
+    if(P_SectorVerify(i, buffer, &stream)) {
       error++;
     };
+    PROF_Switch(PROF_OTHER);
+    /* a mismatch ends the compare early, the load has to finish anyway */
+    res = STREAM_Sync(&stream, SECTOR_SIZE * 2);
+    if(res != FR_OK) break;
+    PROF_Sector(i);
+  }
+  STREAM_Close(&stream);
+  f_close(&file);
+  if(res != FR_OK) {
+    LCD_xyprintf(0, 4, 1, "Read error: %s\n", get_fresult_name(res));
   }
-  LCD_printf(error ? 1 : 2, "Verify done,\n%d bad blocks.\nTime: %d\n", error, (ticks-starttime) / 100);
+  verify_done:
+  PROF_Save("verify", CHIP_P);
+  LCD_xyprintf(0, 1, error ? 1 : 2, "Verify done,\n%d bad blocks.\nTime: %d\n", error, (ticks-starttime) / 100);
+  waitButton();
+  PROF_Summary();
   waitButton();
 }
 
 void P_Dump() {
   FIL file;
   FRESULT res;
+  stream_t stream;
+  uint32_t crc;
 
   uint32_t starttime = ticks;
 
   P_Init();
 
   LCD_Clear();
-  P_genDescrambleLookup();
+  P_genDescrambleLookup(0);
+  PROF_Start();
 
   res = f_open(&file, DUMP_FILENAMES[CHIP_P], FA_CREATE_ALWAYS | FA_WRITE);
   if(check_fresult(res, "Could not open file\n%s\n", DUMP_FILENAMES[CHIP_P])) {
     return;
   }
+  res = STREAM_Create(&stream, &file, (FSIZE_t)END_ADDRESS_P * 2);
+  if(check_fresult(res, "Could not allocate\n%s\n", DUMP_FILENAMES[CHIP_P])) {
+    f_close(&file);
+    return;
+  }
 
+  /* The buffer is processed in chunks: while a chunk is written to the card
+     by DMA, the next one is read from the chip. */
   LCD_xyprintf(0, 2, 0, "-> %s\n", DUMP_FILENAMES[CHIP_P]);
   for(int i = 0; i < END_ADDRESS_P; i += SECTOR_SIZE) {
-    LCD_xyprintf(0, 0, 0, "Dumping %3d%%\n", (int)((double)100.0*(double)i/(double)END_ADDRESS_P+0.5));
-    P_SectorDump(i, buffer);
-    P_ScrambleBuffer(buffer, SECTOR_SIZE);
-    res = f_write(&file, buffer, SECTOR_SIZE * 2, NULL);
-    if(check_fresult(res, "File write error\n")) {
-      f_close(&file);
-      return;
+    STATUS_Post(STATUS_DUMPING, 0, (int)((double)100.0*(double)i/(double)END_ADDRESS_P+0.5), 0);
+    CRC32_Start();
+    for(int j = 0; j < SECTOR_SIZE; j += STREAM_DUMP_CHUNK / 2) {
+      uint16_t *chunk = buffer + j;
+      PROF_Switch(PROF_BUS);
+      P_SectorDump(i + j, chunk, STREAM_DUMP_CHUNK / 2);
+      PROF_Switch(PROF_OTHER);
+      CRC32_Update(chunk, STREAM_DUMP_CHUNK);
+      res = STREAM_Sync(&stream, STREAM_DUMP_CHUNK);
+      if(res == FR_OK) {
+        res = STREAM_Write(&stream, chunk, (FSIZE_t)(i + j) * 2, STREAM_DUMP_CHUNK);
+      }
+      if(res != FR_OK) {
+        STREAM_Close(&stream);
+        f_close(&file);
+        check_fresult(res, "File write error\n");
+        return;
+      }
     }
+    MAN_Record(i / SECTOR_SIZE, CRC32_Value(), 0);
+    PROF_Sector(i);
   }
+  res = STREAM_Sync(&stream, STREAM_DUMP_CHUNK);
+  STREAM_Close(&stream);
   f_close(&file);
-  LCD_printf(2, "Dump finished!      \n");
+  if(check_fresult(res, "File write error\n")) {
+    return;
+  }
+  res = HASH_Save(CHIP_P, SECTOR_SIZE * 2, END_ADDRESS_P / SECTOR_SIZE, &crc);
+  PROF_Save("dump", CHIP_P);
+  LCD_xyprintf(0, 1, 2, "Dump finished!      \n");
+  if(res == FR_OK) {
+    LCD_printf(2, "CRC32 %08lx       \n", (unsigned long)crc);
+  } else {
+    LCD_printf(1, "No .crc: %s\n", get_fresult_name(res));
+  }
   LCD_printf(2, "Time: %d s        \n", (ticks - starttime) / 100);
   waitButton();
-}
\ No newline at end of file
+  PROF_Summary();
+  waitButton();
+}
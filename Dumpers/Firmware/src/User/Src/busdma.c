@@ -0,0 +1,138 @@
+#include "main.h"
+#include "busdma.h"
+
+/*
+ * Timer paced bus reads
+ * =====================
+ *
+ * Bulk reads (dumps) don't need the CPU to toggle every address line. TIM2
+ * runs with a period of one bus cycle and raises three DMA requests per
+ * cycle:
+ *
+ *   CC1 (start of cycle)  DMA2 stream 0 writes the next A0-A11 pattern from
+ *                         busdma_addr[] to GPIOB->BSRR
+ *   CC2 (sample point)    DMA2 stream 1 copies GPIOA->IDR (D0-D7) to busdma_lo
+ *   CC3 (sample point)    DMA2 stream 2 copies GPIOC->IDR (D8-D15) to busdma_hi
+ *
+ * The BSRR patterns only touch A0-A11, so the caller sets the upper address
+ * lines and asserts CE#/OE# before starting a burst and the DMA walks through
+ * one BUSDMA_BURST aligned block. The address table never changes and is
+ * built once by BUSDMA_Init().
+ *
+ * Samples land in one of two staging slots, so the caller can merge the
+ * previous burst into the sector buffer while the next one runs.
+ */
+
+static uint32_t busdma_addr[BUSDMA_BURST] D2SRAM_BUFFER ALIGN(32);
+uint8_t busdma_lo[2][BUSDMA_BURST] D2SRAM_BUFFER ALIGN(32);
+uint8_t busdma_hi[2][BUSDMA_BURST] D2SRAM_BUFFER ALIGN(32);
+
+static DMA_HandleTypeDef hdma_addr;
+static DMA_HandleTypeDef hdma_lo;
+static DMA_HandleTypeDef hdma_hi;
+
+static uint8_t busdma_slot;
+static uint8_t busdma_active;
+static uint32_t busdma_count;
+
+static void BUSDMA_InitStream(DMA_HandleTypeDef *hdma, DMA_Stream_TypeDef *instance, uint32_t request, uint32_t direction, uint32_t align) {
+  hdma->Instance = instance;
+  hdma->Init.Request = request;
+  hdma->Init.Direction = direction;
+  hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+  hdma->Init.MemInc = DMA_MINC_ENABLE;
+  hdma->Init.PeriphDataAlignment = (align == 4) ? DMA_PDATAALIGN_WORD : DMA_PDATAALIGN_BYTE;
+  hdma->Init.MemDataAlignment = (align == 4) ? DMA_MDATAALIGN_WORD : DMA_MDATAALIGN_BYTE;
+  hdma->Init.Mode = DMA_NORMAL;
+  hdma->Init.Priority = DMA_PRIORITY_VERY_HIGH;
+  hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+  HAL_DMA_Init(hdma);
+}
+
+static void BUSDMA_Stop(void) {
+  TIM2->CR1 = 0;
+  TIM2->DIER = 0;
+  TIM2->SR = 0;
+}
+
+void BUSDMA_Init(void) {
+  uint32_t clk = HAL_RCC_GetPCLK1Freq() * 2; // APB1 prescaler != 1
+  uint32_t period = (uint64_t)clk * BUSDMA_CYCLE_NS / 1000000000;
+  uint32_t sample = (uint64_t)clk * BUSDMA_SAMPLE_NS / 1000000000;
+
+  for(int i = 0; i < BUSDMA_BURST; i++) {
+    busdma_addr[i] = (0x0fff << 16) | i;
+  }
+  SCB_CleanDCache_by_Addr(busdma_addr, sizeof(busdma_addr));
+
+  __HAL_RCC_DMA2_CLK_ENABLE();
+  BUSDMA_InitStream(&hdma_addr, DMA2_Stream0, DMA_REQUEST_TIM2_CH1, DMA_MEMORY_TO_PERIPH, 4);
+  BUSDMA_InitStream(&hdma_lo, DMA2_Stream1, DMA_REQUEST_TIM2_CH2, DMA_PERIPH_TO_MEMORY, 1);
+  BUSDMA_InitStream(&hdma_hi, DMA2_Stream2, DMA_REQUEST_TIM2_CH3, DMA_PERIPH_TO_MEMORY, 1);
+
+  __HAL_RCC_TIM2_CLK_ENABLE();
+  BUSDMA_Stop();
+  TIM2->PSC = 0;
+  TIM2->ARR = period - 1;
+  TIM2->CCR1 = 1;
+  TIM2->CCR2 = sample;
+  TIM2->CCR3 = sample;
+  TIM2->CCMR1 = 0; // frozen output compare, no pins
+  TIM2->CCMR2 = 0;
+  TIM2->CCER = 0;
+  TIM2->EGR = TIM_EGR_UG;
+  TIM2->SR = 0;
+}
+
+/**
+ * @brief Start a burst of bus reads. Upper address lines, CE# and OE# must
+ *        already be set, A0-A11 start at 0.
+ *
+ * @param count number of words, up to BUSDMA_BURST
+ * @return staging slot the data will land in, -1 on error
+ */
+int BUSDMA_Start(uint32_t count) {
+  uint8_t slot = busdma_slot;
+
+  BUSDMA_Stop();
+  TIM2->CNT = 0;
+  if(HAL_DMA_Start(&hdma_addr, (uint32_t)busdma_addr, (uint32_t)&GPIOB->BSRR, count) != HAL_OK ||
+     HAL_DMA_Start(&hdma_lo, (uint32_t)&GPIOA->IDR, (uint32_t)busdma_lo[slot], count) != HAL_OK ||
+     HAL_DMA_Start(&hdma_hi, (uint32_t)&GPIOC->IDR, (uint32_t)busdma_hi[slot], count) != HAL_OK) {
+    HAL_DMA_Abort(&hdma_addr);
+    HAL_DMA_Abort(&hdma_lo);
+    HAL_DMA_Abort(&hdma_hi);
+    return -1;
+  }
+  busdma_active = slot;
+  busdma_count = count;
+  busdma_slot ^= 1;
+  TIM2->DIER = TIM_DIER_CC1DE | TIM_DIER_CC2DE | TIM_DIER_CC3DE;
+  TIM2->CR1 = TIM_CR1_CEN;
+  return slot;
+}
+
+/**
+ * @brief Wait for the running burst to finish
+ *
+ * @return 0 = OK, 1 = DMA error or timeout
+ */
+int BUSDMA_Wait(void) {
+  int err = 0;
+
+  if(HAL_DMA_PollForTransfer(&hdma_addr, HAL_DMA_FULL_TRANSFER, BUSDMA_TIMEOUT) != HAL_OK ||
+     HAL_DMA_PollForTransfer(&hdma_lo, HAL_DMA_FULL_TRANSFER, BUSDMA_TIMEOUT) != HAL_OK ||
+     HAL_DMA_PollForTransfer(&hdma_hi, HAL_DMA_FULL_TRANSFER, BUSDMA_TIMEOUT) != HAL_OK) {
+    err = 1;
+  }
+  BUSDMA_Stop();
+  if(err) {
+    HAL_DMA_Abort(&hdma_addr);
+    HAL_DMA_Abort(&hdma_lo);
+    HAL_DMA_Abort(&hdma_hi);
+  }
+  /* D2 SRAM is cacheable */
+  SCB_InvalidateDCache_by_Addr(busdma_lo[busdma_active], busdma_count);
+  SCB_InvalidateDCache_by_Addr(busdma_hi[busdma_active], busdma_count);
+  return err;
+}
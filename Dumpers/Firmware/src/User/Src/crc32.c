@@ -0,0 +1,58 @@
+#include "main.h"
+#include "crc32.h"
+
+/*
+ * Hardware CRC32
+ * ==============
+ *
+ * The CRC unit is set up for the CRC-32 used by zlib, MAME and the
+ * compiler (polynomial 0x04c11db7, reflected, initial value and final XOR
+ * 0xffffffff), so results can be compared with CRCs computed on a PC.
+ * Input is fed a 32 bit word at a time with bit reversal by word, which
+ * processes the bytes in memory order on a little-endian CPU.
+ *
+ * The unit keeps its state between CRC32_Update() calls, so a CRC can be
+ * built up from chunks as long as nothing else uses it meanwhile.
+ */
+
+void CRC32_Init(void) {
+  __HAL_RCC_CRC_CLK_ENABLE();
+  CRC->POL = 0x04c11db7;
+  CRC->INIT = 0xffffffff;
+  CRC->CR = CRC_CR_REV_IN | CRC_CR_REV_OUT; // 32 bit polynomial
+}
+
+void CRC32_Start(void) {
+  CRC->CR |= CRC_CR_RESET;
+}
+
+/**
+ * @brief Add data to the running CRC
+ *
+ * @param data buffer, 32 bit aligned
+ * @param length number of bytes, multiple of 4
+ */
+void CRC32_Update(const void *data, uint32_t length) {
+  const uint32_t *p = data;
+
+  for(uint32_t i = 0; i < length / 4; i++) {
+    CRC->DR = p[i];
+  }
+}
+
+uint32_t CRC32_Value(void) {
+  return ~CRC->DR;
+}
+
+/**
+ * @brief CRC32 of a buffer
+ *
+ * @param data buffer, 32 bit aligned
+ * @param length number of bytes, multiple of 4
+ * @return uint32_t CRC32
+ */
+uint32_t CRC32_Buffer(const void *data, uint32_t length) {
+  CRC32_Start();
+  CRC32_Update(data, length);
+  return CRC32_Value();
+}
@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include "main.h"
+#include "delta.h"
+
+/*
+ * Delta programming
+ * =================
+ *
+ * A new build of the compiler usually differs from the one on the cart in a
+ * few sectors only (a game added or swapped), but programming still reads
+ * every sector back to find them. The compiler writes a list of the sectors
+ * that differ from its last builds next to each image (crom-1 -> crom-1.dlt):
+ *
+ *   VTXDLT 1 <sector bytes> <image bytes> <build id>     all hex
+ *   <base id> <runs>                                     per earlier build
+ *   <first sector> <count>                               per run
+ *
+ * A build id is the CRC32 of the image's sector CRC32s (little endian). The
+ * section whose base is the image's own build has no runs.
+ *
+ * When an image has been programmed completely, the programmer keeps one
+ * record per chip type, <chip>.last (crom.last):
+ *
+ *   <build id> <image name>
+ *
+ * It is removed when any image is programmed onto that chip type (also on
+ * resume) and when the chip is erased, so a job that did not complete
+ * leaves none. The next time the same image is programmed, DLT_Offer()
+ * looks up the section of that build and, if the user confirms, marks all
+ * other sectors done in the journal: only the listed ones are read from
+ * the card, checked and programmed.
+ *
+ * The record says what this programmer last put on a chip of that type,
+ * not which cart is in the socket; that is what the question is for.
+ * Sectors that are not listed are not looked at, a verify afterwards checks
+ * the whole chip. Like a manifest, a list that does not match the image
+ * size is ignored, and a part of a larger image ("crom:2") has none.
+ */
+
+static uint8_t dlt_changed[DLT_MAX_SECTORS / 8];
+
+static void DLT_Name(char *name, const char *image, const char *ext) {
+  strncpy(name, image, FF_MAX_LFN);
+  name[FF_MAX_LFN] = 0;
+  strcat(name, ext);
+}
+
+/* <dump name without extension> + DLT_LAST_EXT */
+static void DLT_LastName(char *name, chip_t chiptype) {
+  const char *dump = DUMP_FILENAMES[chiptype];
+  int n;
+
+  for(n = 0; dump[n] && dump[n] != '.' && n < 16; n++) {
+    name[n] = dump[n];
+  }
+  strcpy(name + n, DLT_LAST_EXT);
+}
+
+/* parse up to count hex fields separated by blanks, returns the number found */
+static int DLT_Parse(const char *line, unsigned long *v, int count) {
+  char *end;
+  int n;
+
+  for(n = 0; n < count; n++) {
+    v[n] = strtoul(line, &end, 16);
+    if(end == line) break;
+    line = end;
+  }
+  return n;
+}
+
+/* open the list of an image and check its header */
+static FRESULT DLT_Open(FIL *file, const char *image, uint32_t sector, uint32_t *build) {
+  char name[FF_MAX_LFN + sizeof(DLT_EXT)];
+  char line[64];
+  FILINFO fno;
+  FRESULT res;
+  unsigned long v[4];     /* version, sector bytes, image bytes, build id */
+
+  if(strchr(image, STREAM_PART_SEP)) return FR_NO_FILE;
+  res = f_stat(image, &fno);
+  if(res != FR_OK) return res;
+  DLT_Name(name, image, DLT_EXT);
+  res = f_open(file, name, FA_READ);
+  if(res != FR_OK) return res;
+  if(!f_gets(line, sizeof(line), file) || strncmp(line, "VTXDLT ", 7)
+     || DLT_Parse(line + 7, v, 4) != 4
+     || v[0] != DLT_VERSION || v[1] != sector || v[2] != (unsigned long)fno.fsize) {
+    f_close(file);
+    return FR_INVALID_OBJECT;
+  }
+  *build = v[3];
+  return FR_OK;
+}
+
+/* build id in <chip>.last, if it was programmed from image */
+static FRESULT DLT_LastBuild(chip_t chiptype, const char *image, uint32_t *build) {
+  char name[24];
+  char line[FF_MAX_LFN + 16];
+  char *end;
+  FIL file;
+  FRESULT res;
+  unsigned long v = 0;
+
+  if(strchr(image, STREAM_PART_SEP)) return FR_NO_FILE;
+  DLT_LastName(name, chiptype);
+  res = f_open(&file, name, FA_READ);
+  if(res != FR_OK) return res;
+  if(!f_gets(line, sizeof(line), &file)) {
+    res = FR_INVALID_OBJECT;
+  } else {
+    v = strtoul(line, &end, 16);
+    line[strcspn(line, "\r\n")] = 0;
+    if(end == line || *end != ' ') {
+      res = FR_INVALID_OBJECT;
+    } else if(strcmp(end + 1, image)) {
+      res = FR_NO_FILE;
+    }
+  }
+  f_close(&file);
+  if(res == FR_OK) *build = v;
+  return res;
+}
+
+/**
+ * @brief Read the sectors of an image that changed since it was last
+ *        programmed, see DLT_IsChanged()
+ *
+ * @param chiptype chip to be programmed
+ * @param image image file name
+ * @param sector sector size in bytes
+ * @param sectors number of sectors of the job
+ * @param changed returns the number of changed sectors
+ * @return FRESULT FR_OK, FR_NO_FILE if there is no list or the chip was
+ *         not programmed completely from this image, FR_INVALID_OBJECT if
+ *         the list does not match the image or has no section for the
+ *         build that was
+ */
+FRESULT DLT_Load(chip_t chiptype, const char *image, uint32_t sector, uint32_t sectors, uint32_t *changed) {
+  FIL file;
+  FRESULT res;
+  char line[32];
+  unsigned long v[2];     /* base id, runs / first sector, count */
+  unsigned long runs;
+  uint32_t build, last;
+  int found = 0;
+
+  if(sectors > DLT_MAX_SECTORS) return FR_INVALID_PARAMETER;
+  res = DLT_LastBuild(chiptype, image, &last);
+  if(res != FR_OK) return res;
+  res = DLT_Open(&file, image, sector, &build);
+  if(res != FR_OK) return res;
+
+  memset(dlt_changed, 0, sizeof(dlt_changed));
+  *changed = 0;
+  while(res == FR_OK && !found && f_gets(line, sizeof(line), &file)) {
+    if(DLT_Parse(line, v, 2) != 2) {
+      res = FR_INVALID_OBJECT;
+      break;
+    }
+    found = v[0] == last;
+    for(runs = v[1]; runs && res == FR_OK; runs--) {
+      if(!f_gets(line, sizeof(line), &file) || DLT_Parse(line, v, 2) != 2
+         || v[0] > sectors || v[1] > sectors - v[0]) {
+        res = FR_INVALID_OBJECT;
+      } else if(found) {
+        for(uint32_t i = v[0]; i < v[0] + v[1]; i++) {
+          if(!DLT_IsChanged(i)) (*changed)++;
+          dlt_changed[i / 8] |= 1 << (i & 7);
+        }
+      }
+    }
+  }
+  f_close(&file);
+  if(res == FR_OK && !found) res = FR_INVALID_OBJECT;
+  return res;
+}
+
+int DLT_IsChanged(uint32_t index) {
+  return index < DLT_MAX_SECTORS && (dlt_changed[index / 8] >> (index & 7)) & 1;
+}
+
+/**
+ * @brief Offer to program only the sectors of an image that changed since
+ *        it was last programmed. Call after JRN_Begin() of a new job.
+ *
+ * @param chiptype chip to be programmed
+ * @param image image file name
+ * @param sector sector size in bytes
+ * @param sectors number of sectors of the job
+ * @return int 1 if the other sectors have been marked done in the journal
+ */
+int DLT_Offer(chip_t chiptype, const char *image, uint32_t sector, uint32_t sectors) {
+  uint32_t changed;
+
+  if(DLT_Load(chiptype, image, sector, sectors, &changed) != FR_OK) return 0;
+  LCD_xyprintf(0, 3, 0, "%lu/%lu sectors changed\nsince last program.\nOnly these?\n",
+               (unsigned long)changed, (unsigned long)sectors);
+  if(!waitYesNo()) {
+    LCD_Clear();
+    return 0;
+  }
+  for(uint32_t i = 0; i < sectors; i++) {
+    if(!DLT_IsChanged(i)) JRN_Done(i);
+  }
+  JRN_Flush();
+  LCD_Clear();
+  return 1;
+}
+
+/* the chips are about to be erased or programmed, the build they had is
+   no base any more */
+void DLT_Forget(chip_t chiptype) {
+  char name[24];
+
+  DLT_LastName(name, chiptype);
+  f_unlink(name);
+}
+
+/**
+ * @brief Remember the build of an image that has been programmed completely
+ *
+ * @param chiptype programmed chip
+ * @param image image file name
+ * @param sector sector size in bytes
+ * @return FRESULT FR_NO_FILE or FR_INVALID_OBJECT if the image has no
+ *         matching list, then nothing is remembered
+ */
+FRESULT DLT_Programmed(chip_t chiptype, const char *image, uint32_t sector) {
+  char name[24];
+  FIL file;
+  FRESULT res;
+  uint32_t build;
+
+  res = DLT_Open(&file, image, sector, &build);
+  if(res != FR_OK) return res;
+  f_close(&file);
+  DLT_LastName(name, chiptype);
+  res = f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE);
+  if(res != FR_OK) return res;
+  if(f_printf(&file, "%08lx %s\n", (unsigned long)build, image) < 0) res = FR_DISK_ERR;
+  if(f_close(&file) != FR_OK && res == FR_OK) res = FR_DISK_ERR;
+  if(res != FR_OK) f_unlink(name);
+  return res;
+}
@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include "main.h"
+#include "hash.h"
+
+/*
+ * Dump checksums
+ * ==============
+ *
+ * The dump loops feed every sector to the CRC unit while it is written to
+ * the card and record the result with MAN_Record(). HASH_Save() then writes
+ * crom.crc / vrom.crc / prom.crc next to the dump:
+ *
+ *   ; comment
+ *   crom.dump <offset> <bytes> <crc32>        whole image
+ *   sector <offset> <bytes> <crc32>           one line per sector
+ *   game <no> <offset> <bytes> <crc32> <menu name>
+ *
+ * Numbers are hex, the CRC32 is the usual zlib one that MAME lists in its
+ * hash files. Whole image and game CRCs are combined from the sector CRCs,
+ * nothing is read back.
+ *
+ * Game lines are only written if the compiler's layout report (VTXCart.log)
+ * is on the card. The log is appended to on every run, the last complete
+ * Report table in it is used: a game starts at its address column and ends
+ * where the next one starts, the last one at the totals line. A game
+ * without data for the chip has the address of the next one and no line. The
+ * compiler aligns games to 1 MB (P, C) or 2 MB (V), so ranges always start
+ * and end on a sector; anything else is skipped.
+ */
+
+typedef struct {
+  uint32_t addr;
+  uint32_t no;
+  char name[HASH_NAME_LEN];
+} hash_game_t;
+
+static hash_game_t hash_games[HASH_MAX_GAMES] D2SRAM_BUFFER;
+
+/* x * mat over GF(2), mat is 32 columns */
+static uint32_t HASH_Gf2Times(const uint32_t *mat, uint32_t vec) {
+  uint32_t sum = 0;
+
+  for(; vec; vec >>= 1, mat++) {
+    if(vec & 1) sum ^= *mat;
+  }
+  return sum;
+}
+
+/* res = a * b */
+static void HASH_Gf2Mul(uint32_t *res, const uint32_t *a, const uint32_t *b) {
+  uint32_t tmp[32];
+
+  for(int n = 0; n < 32; n++) {
+    tmp[n] = HASH_Gf2Times(a, b[n]);
+  }
+  memcpy(res, tmp, sizeof(tmp));
+}
+
+/*
+ * Operator that appends len zero bytes to a CRC (zlib's crc32_combine()),
+ * so that crc(A + B) = HASH_Gf2Times(op, crc(A)) ^ crc(B) for len(B) = len.
+ */
+static void HASH_ZerosOp(uint32_t *op, uint32_t len) {
+  uint32_t sq[32];
+
+  /* one zero bit */
+  sq[0] = 0xedb88320;
+  for(int n = 1; n < 32; n++) {
+    sq[n] = 1u << (n - 1);
+  }
+  /* one zero byte */
+  for(int n = 0; n < 3; n++) {
+    HASH_Gf2Mul(sq, sq, sq);
+  }
+  for(int n = 0; n < 32; n++) {
+    op[n] = 1u << n;
+  }
+  for(; len; len >>= 1) {
+    if(len & 1) HASH_Gf2Mul(op, sq, op);
+    if(len > 1) HASH_Gf2Mul(sq, sq, sq);
+  }
+}
+
+/* CRC of sectors [first, last) */
+static uint32_t HASH_Range(const uint32_t *op, uint32_t first, uint32_t last) {
+  uint32_t crc = 0;
+
+  for(uint32_t i = first; i < last; i++) {
+    crc = HASH_Gf2Times(op, crc) ^ MAN_SectorCrc(i);
+  }
+  return crc;
+}
+
+/* n-th tab separated field of a log line */
+static const char *HASH_Field(const char *line, int n) {
+  while(n-- > 0) {
+    line = strchr(line, '\t');
+    if(!line) return NULL;
+    line++;
+  }
+  return line;
+}
+
+/* 0x%08X field; the compiler prints negative (unused) addresses differently */
+static int HASH_Hex(const char *s, uint32_t *v) {
+  char *end;
+
+  if(!s || s[0] != '0' || (s[1] != 'x' && s[1] != 'X') || !isxdigit((unsigned char)s[2])) {
+    return 0;
+  }
+  *v = strtoul(s + 2, &end, 16);
+  return end - (s + 2) <= 8 && (*end == '\t' || *end == '\r' || *end == '\n' || !*end);
+}
+
+/**
+ * @brief Read the games of the last Report table in the layout report
+ *
+ * @param column address column of the chip in the table
+ * @param end returns the end of the last game
+ * @return int number of games, sorted by address, 0 if there is no table
+ */
+static int HASH_LoadGames(int column, uint32_t *end) {
+  enum { LOG_NONE, LOG_HEADER, LOG_ROWS, LOG_TOTALS, LOG_DONE } state = LOG_NONE;
+  char line[128];
+  FIL file;
+  int count = 0, partial = 0;
+
+  if(f_open(&file, HASH_LOG_FILE, FA_READ) != FR_OK) return 0;
+  while(f_gets(line, sizeof(line), &file)) {
+    /* skip the rest of lines that did not fit */
+    int cont = partial;
+    partial = !strchr(line, '\n') && !f_eof(&file);
+    if(cont) continue;
+
+    if(!strncmp(line, "no\tngh\t", 7)) {
+      state = LOG_HEADER;
+      count = 0;
+    } else if(line[0] == '-' && (state == LOG_HEADER || state == LOG_ROWS)) {
+      state = state == LOG_HEADER ? LOG_ROWS : LOG_TOTALS;
+    } else if(state == LOG_ROWS && isdigit((unsigned char)line[0])) {
+      hash_game_t *g = &hash_games[count];
+      const char *name = HASH_Field(line, 8);
+      int n = 0;
+
+      if(count == HASH_MAX_GAMES || !HASH_Hex(HASH_Field(line, column), &g->addr)) continue;
+      g->no = strtoul(line, NULL, 10);
+      while(name && name[n] && name[n] != '\r' && name[n] != '\n' && n < HASH_NAME_LEN - 1) {
+        g->name[n] = name[n];
+        n++;
+      }
+      g->name[n] = 0;
+      count++;
+    } else if(state == LOG_TOTALS) {
+      /* the totals line has one more leading tab than the rows */
+      state = HASH_Hex(HASH_Field(line, column + 1), end) ? LOG_DONE : LOG_NONE;
+    }
+  }
+  f_close(&file);
+  if(state != LOG_DONE) return 0;
+
+  /* insertion sort by address, keeps the table order for equal ones */
+  for(int i = 1; i < count; i++) {
+    hash_game_t g = hash_games[i];
+    int j;
+    for(j = i; j > 0 && hash_games[j - 1].addr > g.addr; j--) {
+      hash_games[j] = hash_games[j - 1];
+    }
+    hash_games[j] = g;
+  }
+  return count;
+}
+
+/**
+ * @brief Write the checksum file of a dump from the sector CRCs recorded
+ *        with MAN_Record()
+ *
+ * @param chiptype dumped chip
+ * @param sector sector size in bytes
+ * @param sectors number of sectors in the dump
+ * @param crc returns the CRC32 of the whole dump
+ * @return FRESULT
+ */
+FRESULT HASH_Save(chip_t chiptype, uint32_t sector, uint32_t sectors, uint32_t *crc) {
+  static uint32_t op[32];
+  const char *dump = DUMP_FILENAMES[chiptype];
+  char name[32];
+  uint32_t size = sector * sectors;
+  uint32_t end = 0;
+  int column, games = 0;
+  FIL file;
+  FRESULT res;
+  int n;
+
+  if(sectors > MAN_MAX_SECTORS) return FR_INVALID_PARAMETER;
+  HASH_ZerosOp(op, sector);
+  *crc = HASH_Range(op, 0, sectors);
+
+  /* prom_addr, crom_addr, vrom_addr */
+  column = chiptype == CHIP_P ? 3 : chiptype == CHIP_C ? 4 : chiptype == CHIP_V ? 5 : 0;
+  if(column) {
+    games = HASH_LoadGames(column, &end);
+  }
+
+  for(n = 0; dump[n] && dump[n] != '.' && n < 16; n++) {
+    name[n] = dump[n];
+  }
+  strcpy(name + n, HASH_EXT);
+  res = f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE);
+  if(res != FR_OK) return res;
+
+  f_printf(&file, "; %s CRC32, offsets and sizes in hex\n", dump);
+  f_printf(&file, "%s %08lx %08lx %08lx\n", dump, 0UL, (unsigned long)size, (unsigned long)*crc);
+  for(uint32_t i = 0; i < sectors; i++) {
+    f_printf(&file, "sector %08lx %08lx %08lx\n", (unsigned long)(i * sector),
+             (unsigned long)sector, (unsigned long)MAN_SectorCrc(i));
+  }
+  if(games) {
+    f_printf(&file, "; games from %s\n", HASH_LOG_FILE);
+  }
+  for(int g = 0; g < games; g++) {
+    uint32_t start = hash_games[g].addr;
+    uint32_t stop = g + 1 < games ? hash_games[g + 1].addr : end;
+
+    /* empty, not sector aligned or not in this dump */
+    if(stop <= start || stop > size || start % sector || stop % sector) continue;
+    if(f_printf(&file, "game %lu %08lx %08lx %08lx %s\n", (unsigned long)hash_games[g].no,
+                (unsigned long)start, (unsigned long)(stop - start),
+                (unsigned long)HASH_Range(op, start / sector, stop / sector),
+                hash_games[g].name) < 0) {
+      res = FR_DISK_ERR;
+      break;
+    }
+  }
+  if(f_close(&file) != FR_OK && res == FR_OK) res = FR_DISK_ERR;
+  return res;
+}
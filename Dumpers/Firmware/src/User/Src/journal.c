@@ -0,0 +1,206 @@
+#include <stddef.h>
+#include "main.h"
+#include "journal.h"
+
+/*
+ * Programming journal
+ * ===================
+ *
+ * prog.state records which sectors of an image have been programmed and
+ * verified, one bit per sector. It is created when programming starts,
+ * flushed every JRN_FLUSH_TICKS and when a job stops early, and deleted
+ * when the job completes. If the dumper loses power or a chip locks up,
+ * main() finds the journal on the next start and resumes with the sectors
+ * that are not marked yet; marked ones are not read again.
+ *
+ * The file holds two copies of the state in separate 512 byte slots, each
+ * with a sequence number and a CRC32. A flush overwrites the older slot, so
+ * a write cut short by a power loss leaves the other one intact. The newer
+ * valid slot wins on load.
+ *
+ * The image size is stored too; a journal is only resumed for the same
+ * image name, size and chip.
+ */
+
+#define JRN_MAGIC         0x4e524a56      /* "VJRN" */
+#define JRN_SLOT          512
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t seq;
+  uint32_t chiptype;
+  uint32_t sectors;
+  uint32_t image_size;
+  char image[JRN_NAME_LEN];
+  uint8_t done[JRN_MAX_SECTORS / 8];
+  uint32_t crc;                           /* CRC32 of everything above */
+} journal_t;
+
+static journal_t jrn;
+static FIL jrn_file;
+static uint8_t jrn_open;
+static uint32_t jrn_flushed;              /* ticks at the last flush */
+
+static int JRN_Valid(const journal_t *j) {
+  return j->magic == JRN_MAGIC && j->version == JRN_VERSION
+      && j->sectors <= JRN_MAX_SECTORS && memchr(j->image, 0, JRN_NAME_LEN)
+      && j->crc == CRC32_Buffer(j, offsetof(journal_t, crc));
+}
+
+/**
+ * @brief Read the journal left by an unfinished programming job
+ *
+ * @param image returns the image file name, JRN_NAME_LEN bytes
+ * @param chiptype returns the chip
+ * @param done returns the number of sectors already done
+ * @param sectors returns the number of sectors of the job
+ * @return FRESULT FR_OK, FR_NO_FILE if there is none, FR_INVALID_OBJECT if
+ *         no slot is valid
+ */
+FRESULT JRN_Load(char *image, chip_t *chiptype, uint32_t *done, uint32_t *sectors) {
+  static journal_t slot;
+  FIL file;
+  FRESULT res;
+  UINT br;
+  int found = 0;
+
+  res = f_open(&file, PROG_SAVE_FILE, FA_READ);
+  if(res != FR_OK) return res;
+  for(int i = 0; i < 2; i++) {
+    if(f_lseek(&file, i * JRN_SLOT) != FR_OK
+       || f_read(&file, &slot, sizeof(slot), &br) != FR_OK || br != sizeof(slot)
+       || !JRN_Valid(&slot)) {
+      continue;
+    }
+    if(!found || slot.seq > jrn.seq) {
+      jrn = slot;
+      found = 1;
+    }
+  }
+  f_close(&file);
+  if(!found) return FR_INVALID_OBJECT;
+
+  strcpy(image, jrn.image);
+  *chiptype = jrn.chiptype;
+  *sectors = jrn.sectors;
+  *done = 0;
+  for(uint32_t i = 0; i < jrn.sectors; i++) {
+    *done += JRN_IsDone(i);
+  }
+  return FR_OK;
+}
+
+/**
+ * @brief Start journaling a programming job
+ *
+ * @param image image name, see STREAM_ImageName()
+ * @param chiptype chip
+ * @param sectors number of sectors of the job
+ * @param resume keep the sectors marked in the journal read by JRN_Load(),
+ *        if it is for the same image
+ * @return FRESULT; without a journal the job still runs, it just cannot be
+ *         resumed
+ */
+FRESULT JRN_Begin(const char *image, chip_t chiptype, uint32_t sectors, int resume) {
+  static char name[STREAM_NAME_LEN];
+  FILINFO fno;
+  FRESULT res;
+
+  jrn_open = 0;
+  STREAM_ImageName(image, name);
+  res = f_stat(name, &fno);
+  if(res == FR_OK && (strlen(image) >= JRN_NAME_LEN || sectors > JRN_MAX_SECTORS)) {
+    res = FR_INVALID_NAME;
+  }
+  if(res != FR_OK) {
+    /* nothing is skipped without a journal */
+    jrn.sectors = 0;
+    return res;
+  }
+
+  if(!resume || strcmp(jrn.image, image) || jrn.chiptype != chiptype
+     || jrn.sectors != sectors || jrn.image_size != (uint32_t)fno.fsize) {
+    memset(&jrn, 0, sizeof(jrn));
+    jrn.magic = JRN_MAGIC;
+    jrn.version = JRN_VERSION;
+    jrn.chiptype = chiptype;
+    jrn.sectors = sectors;
+    jrn.image_size = (uint32_t)fno.fsize;
+    strcpy(jrn.image, image);
+  }
+
+  res = f_open(&jrn_file, PROG_SAVE_FILE, FA_OPEN_ALWAYS | FA_WRITE);
+  if(res != FR_OK) {
+    jrn.sectors = 0;
+    return res;
+  }
+  jrn_open = 1;
+  /* both slots, so the file has its final size from the start */
+  res = JRN_Flush();
+  if(res == FR_OK) res = JRN_Flush();
+  if(res != FR_OK) {
+    JRN_Delete();
+    jrn.sectors = 0;
+  }
+  return res;
+}
+
+int JRN_IsDone(uint32_t index) {
+  return index < jrn.sectors && (jrn.done[index / 8] >> (index & 7)) & 1;
+}
+
+/* first sector from index on that is not done, jrn.sectors if none */
+uint32_t JRN_Next(uint32_t index) {
+  while(index < jrn.sectors && JRN_IsDone(index)) {
+    index++;
+  }
+  return index;
+}
+
+/**
+ * @brief Mark a sector as programmed and verified, flushes the journal
+ *        every JRN_FLUSH_TICKS
+ */
+void JRN_Done(uint32_t index) {
+  if(index >= jrn.sectors) return;
+  jrn.done[index / 8] |= 1 << (index & 7);
+  if(jrn_open && ticks - jrn_flushed >= JRN_FLUSH_TICKS) {
+    JRN_Flush();
+  }
+}
+
+FRESULT JRN_Flush(void) {
+  FRESULT res;
+  UINT bw;
+
+  if(!jrn_open) return FR_NO_FILE;
+  jrn.seq++;
+  jrn.crc = CRC32_Buffer(&jrn, offsetof(journal_t, crc));
+  res = f_lseek(&jrn_file, (jrn.seq & 1) * JRN_SLOT);
+  if(res == FR_OK) res = f_write(&jrn_file, &jrn, sizeof(jrn), &bw);
+  if(res == FR_OK && bw != sizeof(jrn)) res = FR_DENIED;
+  if(res == FR_OK) res = f_sync(&jrn_file);
+  jrn_flushed = ticks;
+  return res;
+}
+
+/* flush and keep the journal for a later resume */
+FRESULT JRN_Close(void) {
+  FRESULT res;
+
+  if(!jrn_open) return FR_NO_FILE;
+  res = JRN_Flush();
+  if(f_close(&jrn_file) != FR_OK && res == FR_OK) res = FR_DISK_ERR;
+  jrn_open = 0;
+  return res;
+}
+
+/* job finished or abandoned */
+void JRN_Delete(void) {
+  if(jrn_open) {
+    f_close(&jrn_file);
+    jrn_open = 0;
+  }
+  f_unlink(PROG_SAVE_FILE);
+}
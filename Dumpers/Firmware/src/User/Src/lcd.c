@@ -147,44 +147,182 @@ static int32_t lcd_recvdata(uint8_t *pdata, uint32_t length)
 }
 
 
-uint16_t lcd_buf[FONT_WIDTH*FONT_HEIGHT] ALIGN(4);
-uint8_t prev_lm, prev_attr[2];
-
-void LCD_ShowChar(uint16_t x, uint16_t y, uint8_t num, uint8_t pal)
+/*
+ * Text renderer
+ * =============
+ *
+ * The TIM1 interrupt only calls LCD_Schedule(). The drawing runs in the
+ * SPI4 interrupt at the lowest priority: LCD_Render() compares the video
+ * buffer against lcd_char_cache/lcd_attr_cache, renders the glyphs of the
+ * next run of changed cells in a line into lcd_run_buf, sets the display
+ * window to the run and hands the pixels to DMA1 stream 0. When SPI4
+ * reports the end of the transfer, the next run is rendered, until no
+ * changed cells are left.
+ *
+ * The CPU only spends a few microseconds per run on the window commands,
+ * the pixels go out in the background. Nothing else may use SPI4 after
+ * LCD_Init().
+ */
+
+/* RAM offset of the 0.96" HannStar panel in landscape orientation */
+#define LCD_X_OFFSET 1
+#define LCD_Y_OFFSET 26
+
+static uint16_t lcd_run_buf[LCD_COLS * FONT_WIDTH * FONT_HEIGHT] D2SRAM_BUFFER ALIGN(32);
+static volatile uint8_t lcd_busy;   /* a refresh is scheduled or running */
+static uint8_t lcd_ready;
+static uint8_t lcd_scan_line;       /* line to look at first */
+
+/* glyph of a character into a buffer of stride pixels per row */
+static void LCD_Glyph(uint16_t *dst, uint32_t stride, uint8_t num, uint8_t pal)
 {
-    uint8_t  xl, yl;
-    uint32_t pixbuf;
-    uint32_t src_addr;
-    uint16_t tgt_addr = 0;
+  uint32_t pixbuf = 0;
+  uint32_t src_addr;
+  int shift = 0; // shift / bit buffer fill
+
+  /* anything else shows as a blank */
+  if ((num < 0x20) || (num > 0x7f)) num = 0x20;
+  num -= 0x20;
+  src_addr = num * FONT_WIDTH * FONT_HEIGHT / 2;
+  for (int yl = 0; yl < FONT_HEIGHT; yl++) {
+    for (int xl = 0; xl < FONT_WIDTH; xl++) {
+      if(shift == 0) {
+        pixbuf = font_src[src_addr++];
+        shift = 8;
+      }
+      dst[xl] = lcd_palette[pal & 3][pixbuf & 0xf];
+      pixbuf >>= 4;
+      shift -= 4;
+    }
+    dst += stride;
+  }
+}
 
-    int shift = 0; // shift / bit buffer fill
+static void LCD_SetWindow(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+  uint8_t caset[4], raset[4];
+
+  x += LCD_X_OFFSET;
+  y += LCD_Y_OFFSET;
+  caset[0] = x >> 8;
+  caset[1] = x;
+  caset[2] = (x + w - 1) >> 8;
+  caset[3] = x + w - 1;
+  raset[0] = y >> 8;
+  raset[1] = y;
+  raset[2] = (y + h - 1) >> 8;
+  raset[3] = y + h - 1;
+  lcd_writereg(ST7735_CASET, caset, 4);
+  lcd_writereg(ST7735_RASET, raset, 4);
+}
 
-    if ((num < 0x20) || (num > 0x7f)) return;
-    num -= 0x20;
-    src_addr = num * FONT_WIDTH * FONT_HEIGHT / 2;
-    for (yl = 0; yl < FONT_HEIGHT; yl++)
-    {
-        for (xl = 0; xl < FONT_WIDTH; xl++)
-        {
-            if(shift == 0) {
-                pixbuf = font_src[src_addr++];
-                shift = 8;
-            }
-            lcd_buf[tgt_addr++] = lcd_palette[pal][pixbuf & 0xf];
-            pixbuf >>= 4;
-            shift -= 4;
-        }
+/* send the next run of changed cells, runs in the SPI4 interrupt */
+static void LCD_Render(void)
+{
+  uint8_t cmd = ST7735_WRITE_RAM;
+
+  for (int n = 0; n < LCD_LINES; n++) {
+    int line = lcd_scan_line;
+    char *chars = video_line[line];
+    uint8_t *attrs = video_attr[line];
+    char run_ch[LCD_COLS];
+    uint8_t run_at[LCD_COLS];
+    int first, len;
+
+    for (first = 0; first < LCD_COLS; first++) {
+      if (lcd_char_cache[line][first] != chars[first]
+       || lcd_attr_cache[line][first] != attrs[first]) break;
+    }
+    if (first == LCD_COLS) {
+      lcd_scan_line = (line + 1) % LCD_LINES;
+      continue;
     }
-    ST7735_FillRGBRect(&st7735_pObj, x, y, (uint8_t *)&lcd_buf, FONT_WIDTH, FONT_HEIGHT);
+    for (len = 0; first + len < LCD_COLS; len++) {
+      int col = first + len;
+      if (lcd_char_cache[line][col] == chars[col]
+       && lcd_attr_cache[line][col] == attrs[col]) break;
+      run_ch[len] = lcd_char_cache[line][col] = chars[col];
+      run_at[len] = lcd_attr_cache[line][col] = attrs[col];
+    }
+    for (int i = 0; i < len; i++) {
+      LCD_Glyph(lcd_run_buf + i * FONT_WIDTH, len * FONT_WIDTH, run_ch[i], run_at[i]);
+    }
+    SCB_CleanDCache_by_Addr((uint32_t *)lcd_run_buf, len * FONT_WIDTH * FONT_HEIGHT * 2);
+    LCD_SetWindow(first * FONT_WIDTH, line * FONT_HEIGHT, len * FONT_WIDTH, FONT_HEIGHT);
+    LCD_CS_RESET;
+    LCD_RS_RESET;
+    HAL_SPI_Transmit(SPI_Drv, &cmd, 1, 100);
+    LCD_RS_SET;
+    if (HAL_SPI_Transmit_DMA(SPI_Drv, (uint8_t *)lcd_run_buf, len * FONT_WIDTH * FONT_HEIGHT * 2) != HAL_OK) {
+      /* draw these again next time */
+      LCD_CS_SET;
+      memset(&lcd_char_cache[line][first], 0, len);
+      break;
+    }
+    return;
+  }
+  lcd_busy = 0;
+}
+
+/* called from the TIM1 interrupt every LCD_REFRESH_INTERVAL */
+void LCD_Schedule(void)
+{
+  if (lcd_ready && !lcd_busy) {
+    lcd_busy = 1;
+    NVIC_SetPendingIRQ(SPI4_IRQn);
+  }
+}
+
+/* SPI4 interrupt: end of a pixel transfer, or a refresh from LCD_Schedule() */
+void LCD_IRQHandler(void)
+{
+  uint32_t t = DWT->CYCCNT;
+
+  if (SPI_Drv->State == HAL_SPI_STATE_READY) {
+    STATUS_Drain(1);
+    LCD_Render();
+  } else {
+    HAL_SPI_IRQHandler(SPI_Drv);
+  }
+  PROF_Isr(PROF_LCD, t);
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+  if (hspi != SPI_Drv) return;
+  LCD_CS_SET;
+  LCD_Render();
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+  if (hspi != SPI_Drv) return;
+  /* redraw everything on the next refresh */
+  LCD_CS_SET;
+  memset(lcd_char_cache, 0, sizeof(lcd_char_cache));
+  lcd_busy = 0;
+}
+
+/* status records from the main loop go out before its direct output, so
+   everything lands on the screen in the order it was written */
+static void LCD_Sync(int show)
+{
+    uint32_t enabled;
+
+    if (!STATUS_Pending()) return;
+    enabled = NVIC_GetEnableIRQ(SPI4_IRQn);
+    NVIC_DisableIRQ(SPI4_IRQn);
+    STATUS_Drain(show);
+    if (enabled) NVIC_EnableIRQ(SPI4_IRQn);
 }
 
 void LCD_Clear(void)
 {
+    LCD_Sync(0);
     memset(video_buf, 0x20, sizeof(video_buf));
     memset(video_attr_buf, 0, sizeof(video_attr_buf));
-    memset(lcd_char_cache, 0x20, sizeof(lcd_char_cache));
-    memset(lcd_attr_cache, 0, sizeof(lcd_attr_cache));
-    ST7735_FillRect(&st7735_pObj, 0, 0, 160, 80, 0x0000);
+    /* no character matches, so the renderer blanks every cell */
+    memset(lcd_char_cache, 0, sizeof(lcd_char_cache));
     cur_x = 0;
     cur_y = 0;
 }
@@ -201,28 +339,8 @@ void LCD_Init(void)
         video_attr[i] = video_attr_buf + 256 * i;
     }
 //    LCD_Generate_Font(font, font_src, FONT_WIDTH, FONT_HEIGHT);
-}
-
-void LCD_UpdateText(void)
-{
-  int x = 0, y = 0;
-//  if (f) LCD_Clear();
-
-  for (int line = 0; line < LCD_LINES; line++) {
-    x = 0;
-    for (int col = 0; col < LCD_COLS; col++) {
-      char ch = video_line[line][col];
-      uint8_t at = video_attr[line][col];
-      if (lcd_char_cache[line][col] != ch
-       || lcd_attr_cache[line][col] != at) {
-        lcd_char_cache[line][col] = ch;
-        lcd_attr_cache[line][col] = at;
-        LCD_ShowChar(x, y, ch, at);
-      }
-      x += FONT_WIDTH;
-    }
-    y += FONT_HEIGHT;
-  }
+    /* from here on SPI4 belongs to the renderer */
+    lcd_ready = 1;
 }
 
 void LCD_setcolor(int c) {
@@ -265,6 +383,7 @@ void LCD_putc(char c) {
 int LCD_vprintf(int c, char *format, va_list ap) {
     int res;
 
+    LCD_Sync(1);
     LCD_setcolor(c);
     res = vxprintf(LCD_putc, format, ap);
     return res;
@@ -274,6 +393,7 @@ int LCD_printf(int c, char *format, ...) {
     va_list ap;
     int res;
 
+    LCD_Sync(1);
     LCD_setcolor(c);
 
     va_start(ap, format);
@@ -286,6 +406,7 @@ int LCD_xyprintf(int x, int y, int c, char *format, ...) {
     va_list ap;
     int res;
 
+    LCD_Sync(1);
     LCD_setattr(x, y, c);
 
     va_start(ap, format);
@@ -293,3 +414,32 @@ int LCD_xyprintf(int x, int y, int c, char *format, ...) {
     va_end(ap);
     return res;
 }
+
+static int status_x, status_y, status_color;
+
+static void LCD_StatusPutc(char c) {
+    if (status_x < LCD_COLS) {
+        video_attr[status_y][status_x] = status_color;
+        video_line[status_y][status_x] = c;
+        status_x++;
+    }
+}
+
+/* one status line from STATUS_Drain(); leaves the cursor alone and clears
+   the rest of the line */
+int LCD_Status(int y, int c, char *format, ...) {
+    va_list ap;
+    int res;
+
+    status_x = 0;
+    status_y = y;
+    status_color = c;
+
+    va_start(ap, format);
+    res = vxprintf(LCD_StatusPutc, format, ap);
+    va_end(ap);
+    while (status_x < LCD_COLS) {
+        LCD_StatusPutc(' ');
+    }
+    return res;
+}
@@ -47,6 +47,8 @@ int main(void)
 
   /* Initialize Timers */
   MX_TIM1_Init();
+  BUSDMA_Init();
+  CRC32_Init();
 
   /* Initialize SD-Card */
   BSP_SD_Init();
@@ -75,24 +77,25 @@ int main(void)
     LCD_xyprintf(0,0,0, "SD Card error %d:\n%s\n", fr, get_fresult_friendlyname(fr));
     waitButton();
   }
-  uint32_t saved_addr;
+  uint32_t saved_done, saved_sectors;
   chip_t saved_chiptype;
-  char saved_filename[80];
+  char saved_filename[JRN_NAME_LEN];
 
-  if(loadProgress(&saved_addr, saved_filename, &saved_chiptype) == FR_OK) {
+  if(JRN_Load(saved_filename, &saved_chiptype, &saved_done, &saved_sectors) == FR_OK) {
     LCD_Clear();
     LCD_printf(2, "Saved Progress found\n");
-    LCD_printf(0, "A:%08lx %s\n", saved_addr, CHIP_NAMES[saved_chiptype]);
+    LCD_printf(0, "%s %lu/%lu done\n", CHIP_NAMES[saved_chiptype], saved_done, saved_sectors);
     LCD_printf(0, "<%s>\n", saved_filename);
     LCD_printf(0, "Resume?\n");
     if(waitYesNo()) {
       switch(saved_chiptype) {
         case CHIP_C:
         case CHIP_V:
-          CV_Program_Internal(saved_filename, saved_addr, saved_chiptype);
+          CV_Program_Internal(saved_filename, 1, saved_chiptype);
           break;
         case CHIP_P:
-          P_Program_Internal(saved_filename, saved_addr);
+          P_Program_Internal(saved_filename, 1);
+          break;
         default:
           LCD_printf(0, "Chip Type %s\nnot implemented\n",CHIP_NAMES[saved_chiptype]);
           waitButton();
@@ -125,7 +128,7 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 
   if (++timLcdCnt >= LCD_REFRESH_INTERVAL) {
     timLcdCnt = 0;
-    LCD_UpdateText();
+    LCD_Schedule();
   }
 
   if (BSP_PB_GetState(BUTTON_BRD) == GPIO_PIN_SET) {
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include "main.h"
+#include "manifest.h"
+
+/*
+ * Image manifests
+ * ===============
+ *
+ * An optional text file next to an image (crom-1 -> crom-1.man) holding the
+ * CRC32 of each flash sector, so verify can compare a CRC of the chip
+ * contents instead of reading the image back from the card:
+ *
+ *   VTXMAN 1 <sector bytes> <image bytes> <flags>     all hex
+ *   <crc32> <blank>                                   one line per sector
+ *
+ * The CRC covers the whole sector of file data, padded with 0xff past the
+ * end of the image. blank = 1 marks an all-0xff sector, which verify checks
+ * with a blank check. The compiler writes manifests along with the images,
+ * the programmer writes one after programming a whole image.
+ *
+ * MAN_FLAG_SCRAMBLED marks an image the compiler has already put into the
+ * order the C/P chips see on the bus (data line and address nibble
+ * permutation of the china pinout). Such an image is programmed and
+ * verified as it is; only the flag tells it apart from a normal one, so it
+ * must not be used without its manifest.
+ *
+ * The image size in the header is the only protection against a manifest
+ * that belongs to an older version of the image; manifests that do not match
+ * the image size or the chip's sector size are ignored. A part of a larger
+ * image ("crom:2") has no manifest.
+ */
+
+static uint32_t man_crc[MAN_MAX_SECTORS] D2SRAM_BUFFER;
+static uint8_t man_blank[MAN_MAX_SECTORS / 8] D2SRAM_BUFFER;
+
+static void MAN_Name(char *name, const char *image) {
+  strncpy(name, image, FF_MAX_LFN);
+  name[FF_MAX_LFN] = 0;
+  strcat(name, MAN_EXT);
+}
+
+/* parse up to count hex fields separated by blanks, returns the number found */
+static int MAN_Parse(const char *line, unsigned long *v, int count) {
+  char *end;
+  int n;
+
+  for(n = 0; n < count; n++) {
+    v[n] = strtoul(line, &end, 16);
+    if(end == line) break;
+    line = end;
+  }
+  return n;
+}
+
+/**
+ * @brief Open the manifest of an image
+ *
+ * @param m manifest state
+ * @param image image file name
+ * @param sector expected sector size in bytes
+ * @return FRESULT FR_OK, FR_NO_FILE if there is none, FR_INVALID_OBJECT if
+ *         it does not match the image
+ */
+FRESULT MAN_Open(manifest_t *m, const char *image, uint32_t sector) {
+  char name[FF_MAX_LFN + sizeof(MAN_EXT)];
+  char line[64];
+  FILINFO fno;
+  FRESULT res;
+  unsigned long v[4];     /* version, sector bytes, image bytes, flags */
+
+  if(strchr(image, STREAM_PART_SEP)) return FR_NO_FILE;
+  res = f_stat(image, &fno);
+  if(res != FR_OK) return res;
+  MAN_Name(name, image);
+  res = f_open(&m->file, name, FA_READ);
+  if(res != FR_OK) return res;
+  if(!f_gets(line, sizeof(line), &m->file) || strncmp(line, "VTXMAN ", 7)
+     || MAN_Parse(line + 7, v, 4) != 4
+     || v[0] != MAN_VERSION || v[1] != sector || v[2] != (unsigned long)fno.fsize) {
+    f_close(&m->file);
+    return FR_INVALID_OBJECT;
+  }
+  m->sector = v[1];
+  m->flags = v[3];
+  return FR_OK;
+}
+
+/**
+ * @brief Read the entry of the next sector
+ *
+ * @param m manifest state
+ * @param crc CRC32 of the sector
+ * @return int 1 = all 0xff, 0 = data, -1 = end of manifest or error
+ */
+int MAN_Next(manifest_t *m, uint32_t *crc) {
+  char line[32];
+  unsigned long v[2];     /* crc, blank */
+
+  if(!f_gets(line, sizeof(line), &m->file) || MAN_Parse(line, v, 2) != 2) {
+    return -1;
+  }
+  *crc = v[0];
+  return v[1] ? 1 : 0;
+}
+
+void MAN_Close(manifest_t *m) {
+  f_close(&m->file);
+}
+
+/**
+ * @brief Remember the CRC of a sector for MAN_Save()
+ *
+ * @param index sector number from the start of the image
+ * @param crc CRC32 of the sector
+ * @param blank sector is all 0xff
+ */
+void MAN_Record(uint32_t index, uint32_t crc, int blank) {
+  if(index >= MAN_MAX_SECTORS) return;
+  man_crc[index] = crc;
+  if(blank) {
+    man_blank[index / 8] |= 1 << (index & 7);
+  } else {
+    man_blank[index / 8] &= ~(1 << (index & 7));
+  }
+}
+
+/* CRC recorded for a sector, also used for the checksums of a dump */
+uint32_t MAN_SectorCrc(uint32_t index) {
+  return index < MAN_MAX_SECTORS ? man_crc[index] : 0;
+}
+
+/**
+ * @brief Header flags of an image's manifest
+ *
+ * @param image image file name
+ * @param sector expected sector size in bytes
+ * @return uint32_t MAN_FLAG_x, 0 if there is no matching manifest
+ */
+uint32_t MAN_Flags(const char *image, uint32_t sector) {
+  manifest_t m;
+
+  if(MAN_Open(&m, image, sector) != FR_OK) return 0;
+  MAN_Close(&m);
+  return m.flags;
+}
+
+/**
+ * @brief Write the manifest of an image from the sectors recorded with
+ *        MAN_Record()
+ *
+ * @param image image file name
+ * @param sector sector size in bytes
+ * @param sectors number of sectors, all of them must have been recorded
+ * @param flags MAN_FLAG_x of the image
+ * @return FRESULT
+ */
+FRESULT MAN_Save(const char *image, uint32_t sector, uint32_t sectors, uint32_t flags) {
+  char name[FF_MAX_LFN + sizeof(MAN_EXT)];
+  FILINFO fno;
+  FIL file;
+  FRESULT res;
+
+  if(sectors > MAN_MAX_SECTORS || strchr(image, STREAM_PART_SEP)) return FR_INVALID_PARAMETER;
+  res = f_stat(image, &fno);
+  if(res != FR_OK) return res;
+  MAN_Name(name, image);
+  res = f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE);
+  if(res != FR_OK) return res;
+  f_printf(&file, "VTXMAN %x %lx %lx %lx\n", MAN_VERSION, (unsigned long)sector, (unsigned long)fno.fsize, (unsigned long)flags);
+  for(uint32_t i = 0; i < sectors; i++) {
+    if(f_printf(&file, "%08lx %d\n", (unsigned long)man_crc[i], (man_blank[i / 8] >> (i & 7)) & 1) < 0) {
+      res = FR_DISK_ERR;
+      break;
+    }
+  }
+  if(f_close(&file) != FR_OK && res == FR_OK) res = FR_DISK_ERR;
+  if(res != FR_OK) f_unlink(name);
+  return res;
+}
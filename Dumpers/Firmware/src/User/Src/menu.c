@@ -168,7 +168,7 @@ FRESULT choose_file(FILINFO *fno, char *path, BYTE mode) {
         f_rewinddir(&dir);
         continue;
       };
-      if(!(fno->fattrib & AM_DIR)) {
+      if(!(fno->fattrib & AM_DIR) && !is_sidecar_file(fno->fname)) {
         print_center(2, fno->fname);
         refresh = 0;
       }
@@ -180,4 +180,44 @@ FRESULT choose_file(FILINFO *fno, char *path, BYTE mode) {
   } while (!(flag_button & FLAG_BTN_BRD_LONG));
   flag_button &= ~FLAG_BTN_BRD_LONG;
   return FR_OK;
+}
+
+/**
+ * @brief Choose an image to program or verify. A file larger than one job
+ *        (all boards of a cart in one exFAT file) is used one part at a
+ *        time; the part is chosen next and added to the name ("crom:2").
+ *
+ * @param image returns the image name, STREAM_NAME_LEN bytes
+ * @param job bytes per job
+ * @return FRESULT
+ */
+FRESULT choose_image(char *image, FSIZE_t job) {
+  static FILINFO fno;
+  char text[LCD_COLS + 1];
+  uint32_t parts, part = 1;
+  int refresh = 1;
+
+  choose_file(&fno, "/", FA_READ);
+  strcpy(image, fno.fname);
+  parts = (fno.fsize + job - 1) / job;
+  if(parts < 2) return FR_OK;
+
+  LCD_Clear();
+  LCD_xyprintf(0, 0, 0, "Choose Part:");
+  print_center(4, fno.fname);
+  do {
+    if(refresh) {
+      snprintf(text, sizeof(text), "%lu of %lu", (unsigned long)part, (unsigned long)parts);
+      print_center(2, text);
+      refresh = 0;
+    }
+    if(flag_button & FLAG_BTN_BRD) {
+      flag_button &= ~FLAG_BTN_BRD;
+      part = part % parts + 1;
+      refresh = 1;
+    }
+  } while (!(flag_button & FLAG_BTN_BRD_LONG));
+  flag_button &= ~FLAG_BTN_BRD_LONG;
+  sprintf(image + strlen(image), "%c%lu", STREAM_PART_SEP, (unsigned long)part);
+  return FR_OK;
 }
\ No newline at end of file
@@ -27,5 +27,6 @@ menu_entry *menu_select(menu_entry *ent);
 extern menu_entry MENU_TOP[];
 
 FRESULT choose_file(FILINFO *fno, char *path, BYTE mode);
+FRESULT choose_image(char *image, FSIZE_t job);
 
 #endif
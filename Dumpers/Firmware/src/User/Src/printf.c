@@ -48,41 +48,39 @@
 /* Digits used for conversion */
 static const char hexdigits[] = "0123456789abcdef";
 
-/* Temporary buffer used for numbers - just large enough for 32 bit in octal */
-static char buffer[12];
-
-/* Output string length */
-static unsigned int outlength;
-
-/* Output pointer */
-static char *outptr;
-static int maxlen;
-
-/* printf */
-// static void outchar(char x) {
-//   if (maxlen) {
-//     maxlen--;
-//     outfunc(x);
-//     outlength++;
-//   }
-// }
-
-/* sprintf */
-static void outstr(char x) {
-  if (maxlen) {
-    maxlen--;
-    *outptr++ = x;
-    outlength++;
+/* State of one call. It lives on the caller's stack, so the LCD refresh
+   interrupt can format status text while the main loop is in the middle of
+   a printf of its own. */
+typedef struct {
+  void (*outfunc)(char c);  /* NULL: sprintf to outptr */
+  char *outptr;             /* Output pointer */
+  int maxlen;
+  unsigned int outlength;   /* Output string length */
+} printf_ctx_t;
+
+static void outchar(printf_ctx_t *ctx, char x) {
+  /* printf */
+  if (ctx->outfunc) {
+    ctx->outfunc(x);
+    return;
+  }
+  /* sprintf */
+  if (ctx->maxlen) {
+    ctx->maxlen--;
+    *ctx->outptr++ = x;
+    ctx->outlength++;
   }
 }
 
-static int internal_nprintf(void (*output_function)(char c), const char *fmt, va_list ap) {
+static int internal_nprintf(printf_ctx_t *ctx, const char *fmt, va_list ap) {
   unsigned int width;
   unsigned int flags;
   unsigned int base = 0;
   char *ptr = NULL;
+  /* Temporary buffer used for numbers - just large enough for 32 bit in octal */
+  char buffer[12];
 
-   outlength = 0;
+  ctx->outlength = 0;
 
   while (*fmt) {
     while (1) {
@@ -95,7 +93,7 @@ static int internal_nprintf(void (*output_function)(char c), const char *fmt, va
           break;
       }
 
-      output_function(*fmt++);
+      outchar(ctx, *fmt++);
     }
 
     flags = 0;
@@ -174,8 +172,8 @@ static int internal_nprintf(void (*output_function)(char c), const char *fmt, va
       break;
 
     case 'p': // pointer
-      output_function('0');
-      output_function('x');
+      outchar(ctx, '0');
+      outchar(ctx, 'x');
       width -= 2;
     case 'x':
     case 'X':
@@ -207,13 +205,13 @@ static int internal_nprintf(void (*output_function)(char c), const char *fmt, va
 
     /* Sign */
     if (flags & FLAG_NEGATIVE) {
-      output_function('-');
+      outchar(ctx, '-');
       width--;
     } else if (flags & FLAG_FORCESIGN) {
-      output_function('+');
+      outchar(ctx, '+');
       width--;
     } else if (flags & FLAG_BLANK) {
-      output_function(' ');
+      outchar(ctx, ' ');
       width--;
     }
 
@@ -222,16 +220,16 @@ static int internal_nprintf(void (*output_function)(char c), const char *fmt, va
     if ((flags & FLAG_WIDTH) && !(flags & FLAG_LEFTADJ)) {
       while (strlen(ptr) < width) {
         if (flags & FLAG_ZEROPAD)
-          output_function('0');
+          outchar(ctx, '0');
         else
-          output_function(' ');
+          outchar(ctx, ' ');
         width--;
       }
     }
 
     /* data */
     while (*ptr) {
-      output_function(*ptr++);
+      outchar(ctx, *ptr++);
       if (width)
         width--;
     }
@@ -239,7 +237,7 @@ static int internal_nprintf(void (*output_function)(char c), const char *fmt, va
     /* right padding */
     if (flags & FLAG_WIDTH) {
       while (width) {
-        output_function(' ');
+        outchar(ctx, ' ');
         width--;
       }
     }
@@ -248,25 +246,25 @@ static int internal_nprintf(void (*output_function)(char c), const char *fmt, va
   }
 
  end:
-  return outlength;
+  return ctx->outlength;
 }
 
 int xprintf(void (*output_function)(char c), const char *format, ...) {
+  printf_ctx_t ctx = { output_function, NULL, -1, 0 };
   va_list ap;
   int res;
 
-  maxlen = -1;
   va_start(ap, format);
-  res = internal_nprintf(output_function, format, ap);
+  res = internal_nprintf(&ctx, format, ap);
   va_end(ap);
   return res;
 }
 
 int vxprintf(void (*output_function)(char c), const char *format, va_list ap) {
+  printf_ctx_t ctx = { output_function, NULL, -1, 0 };
   int res;
 
-  maxlen = -1;
-  res = internal_nprintf(output_function, format, ap);
+  res = internal_nprintf(&ctx, format, ap);
   return res;
 }
 
@@ -290,13 +288,12 @@ int vxprintf(void (*output_function)(char c), const char *format, va_list ap) {
 // }
 
 int snprintf(char *str, size_t size, const char *format, ...) {
+  printf_ctx_t ctx = { NULL, str, size, 0 };
   va_list ap;
   int res;
 
-  maxlen = size;
-  outptr = str;
   va_start(ap, format);
-  res = internal_nprintf(outstr, format, ap);
+  res = internal_nprintf(&ctx, format, ap);
   va_end(ap);
   if (res < size)
     str[res] = 0;
@@ -304,10 +301,10 @@ int snprintf(char *str, size_t size, const char *format, ...) {
 }
 
 int vsnprintf(char *str, size_t size, const char *format, va_list ap) {
+  printf_ctx_t ctx = { NULL, str, size, 0 };
   int res;
-  maxlen = size;
-  outptr = str;
-  res = internal_nprintf(outstr, format, ap);
+
+  res = internal_nprintf(&ctx, format, ap);
   if (res < size)
     str[res] = 0;
   return res;
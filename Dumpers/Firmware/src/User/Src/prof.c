@@ -0,0 +1,180 @@
+#include "main.h"
+#include "prof.h"
+
+/*
+ * Job profiler
+ * ============
+ *
+ * Splits the time of a program/verify/dump job into what the CPU was doing,
+ * using the DWT cycle counter. Exactly one counter runs at a time: code
+ * switches to its counter with PROF_Switch() and restores the previous one
+ * when done, so nested sections are charged to the innermost one. Time
+ * spent in interrupt handlers that report it with PROF_Isr() is taken out
+ * of the foreground counter.
+ *
+ * PROF_Sector() closes a log entry with the time spent per counter since
+ * the previous one. PROF_Save() ends the job and writes the log as CSV
+ * (microseconds per sector), PROF_Summary() shows the job totals on the LCD.
+ *
+ * Words are de/scrambled inside the bus loops, one at a time between bus
+ * cycles, so that time is part of PROF_BUS.
+ *
+ * CYCCNT wraps after ~9 s at 480 MHz, so a counter must not run longer
+ * than that without a switch or sector mark.
+ */
+
+static const char *prof_names[PROF_COUNTERS] = {
+  "other", "bus", "sd_read", "sd_write", "erase", "program", "status", "lcd"
+};
+static const char *prof_short[PROF_COUNTERS] = {
+  "Oth", "Bus", "SDr", "SDw", "Ers", "Prg", "Sts", "LCD"
+};
+
+prof_counter_t prof_current;
+volatile uint32_t prof_isr_cycles[PROF_COUNTERS];
+
+static uint32_t prof_last;                    /* CYCCNT at the last switch */
+static uint32_t prof_isr_seen[PROF_COUNTERS]; /* interrupt cycles already charged */
+static uint64_t prof_total[PROF_COUNTERS];    /* cycles since PROF_Start() */
+static uint64_t prof_mark[PROF_COUNTERS];     /* totals at the last sector mark */
+static uint64_t prof_job[PROF_COUNTERS];      /* totals at the end of the job */
+static uint32_t prof_log_count;
+static prof_sector_t prof_log[PROF_LOG_SIZE] D2SRAM_BUFFER;
+
+/* charge the time since the last switch to the running counter */
+static void PROF_Charge(void) {
+  uint32_t now = DWT->CYCCNT;
+  uint32_t elapsed = now - prof_last;
+  uint32_t isr = 0;
+
+  for(int i = 0; i < PROF_COUNTERS; i++) {
+    uint32_t d = prof_isr_cycles[i] - prof_isr_seen[i];
+    prof_isr_seen[i] += d;
+    prof_total[i] += d;
+    isr += d;
+  }
+  prof_total[prof_current] += elapsed > isr ? elapsed - isr : 0;
+  prof_last = now;
+}
+
+/**
+ * @brief Reset all counters and the sector log, start charging PROF_OTHER
+ */
+void PROF_Start(void) {
+  prof_current = PROF_OTHER;
+  prof_log_count = 0;
+  for(int i = 0; i < PROF_COUNTERS; i++) {
+    prof_isr_seen[i] = prof_isr_cycles[i];
+    prof_total[i] = 0;
+    prof_mark[i] = 0;
+  }
+  prof_last = DWT->CYCCNT;
+}
+
+/**
+ * @brief Switch to another counter
+ *
+ * @param counter counter to charge from now on
+ * @return prof_counter_t the previous counter, for restoring it
+ */
+prof_counter_t PROF_Switch(prof_counter_t counter) {
+  prof_counter_t prev = prof_current;
+
+  PROF_Charge();
+  prof_current = counter;
+  return prev;
+}
+
+/**
+ * @brief Close the log entry of a sector
+ *
+ * @param addr sector address
+ */
+void PROF_Sector(uint32_t addr) {
+  uint32_t cycles_per_us = SystemCoreClock / 1000000;
+  prof_sector_t *e;
+
+  PROF_Charge();
+  if(prof_log_count < PROF_LOG_SIZE) {
+    e = &prof_log[prof_log_count++];
+    e->addr = addr;
+    for(int i = 0; i < PROF_COUNTERS; i++) {
+      e->us[i] = (prof_total[i] - prof_mark[i]) / cycles_per_us;
+    }
+  }
+  memcpy(prof_mark, prof_total, sizeof(prof_mark));
+}
+
+/**
+ * @brief End the job and write the sector log to <dump name>_<job>.csv,
+ *        e.g. crom_prog.csv
+ *
+ * @param job job name
+ * @param chiptype chip the job ran on
+ * @return FRESULT
+ */
+FRESULT PROF_Save(const char *job, chip_t chiptype) {
+  char name[32];
+  const char *stem = DUMP_FILENAMES[chiptype];
+  FIL file;
+  FRESULT res;
+  int n;
+
+  PROF_Charge();
+  memcpy(prof_job, prof_total, sizeof(prof_job));
+  for(n = 0; stem[n] && stem[n] != '.' && n < 16; n++) {
+    name[n] = stem[n];
+  }
+  name[n++] = '_';
+  strncpy(name + n, job, sizeof(name) - n - 5);
+  name[sizeof(name) - 5] = 0;
+  strcat(name, ".csv");
+
+  res = f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE);
+  if(res != FR_OK) {
+    return res;
+  }
+  f_puts("addr", &file);
+  for(int i = 0; i < PROF_COUNTERS; i++) {
+    f_printf(&file, ",%s_us", prof_names[i]);
+  }
+  f_putc('\n', &file);
+  for(uint32_t s = 0; s < prof_log_count; s++) {
+    f_printf(&file, "%08lx", (unsigned long)prof_log[s].addr);
+    for(int i = 0; i < PROF_COUNTERS; i++) {
+      f_printf(&file, ",%lu", (unsigned long)prof_log[s].us[i]);
+    }
+    if(f_putc('\n', &file) < 0) {
+      break;
+    }
+  }
+  res = f_error(&file) ? FR_DISK_ERR : FR_OK;
+  if(f_close(&file) != FR_OK) {
+    res = FR_DISK_ERR;
+  }
+  return res;
+}
+
+/**
+ * @brief Show the totals of the last saved job on the LCD, in seconds
+ */
+void PROF_Summary(void) {
+  uint32_t cycles_per_ds = SystemCoreClock / 10;
+  uint64_t sum = 0;
+  uint32_t ds;
+
+  LCD_Clear();
+  for(int i = 0; i <= PROF_COUNTERS; i++) {
+    if(i < PROF_COUNTERS) {
+      sum += prof_job[i];
+      ds = prof_job[i] / cycles_per_ds;
+    } else {
+      ds = sum / cycles_per_ds;
+    }
+    LCD_printf(i < PROF_COUNTERS ? 0 : 2, "%s%5lu.%lu", i < PROF_COUNTERS ? prof_short[i] : "Tot",
+               (unsigned long)(ds / 10), (unsigned long)(ds % 10));
+    if(i & 1) {
+      LCD_printf(0, "\n");
+    }
+  }
+}
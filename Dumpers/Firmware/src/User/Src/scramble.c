@@ -0,0 +1,64 @@
+#include "main.h"
+#include "scramble.h"
+
+/*
+ * Data line de/scrambling
+ * =======================
+ *
+ * The adapters route the data lines to the chips in a different order
+ * ("china pinout"). Since this is a pure bit permutation, each 16 bit word
+ * can be translated as lo[word & 0xff] | hi[word >> 8], using two 256 entry
+ * tables per direction instead of a 64k entry table.
+ *
+ * The tables are generated by the preprocessor from the bit maps below.
+ * They are not const so they are placed in .data, which is copied to DTCM
+ * at startup; lookups never touch the D-cache.
+ *
+ * Sector buffers always hold file data. Words are scrambled on their way
+ * to the chip (program, verify) and descrambled as they come off the bus
+ * (dump) with SCRAMBLE_Word().
+ */
+
+/* move bit `from` of v to bit `to` */
+#define B(v, from, to) ((((v) >> (from)) & 1) << (to))
+
+/* C/V: data bits 7:0 / 15:8 of the file -> chip */
+#define CV_SCR_LO(v)  (B(v,0,5)  | B(v,1,8)  | B(v,2,3)  | B(v,3,11) | B(v,4,7)  | B(v,5,9)  | B(v,6,13) | B(v,7,12))
+#define CV_SCR_HI(v)  (B(v,0,2)  | B(v,1,1)  | B(v,2,15) | B(v,3,14) | B(v,4,0)  | B(v,5,10) | B(v,6,4)  | B(v,7,6))
+/* C/V: data bits 7:0 / 15:8 of the chip -> file */
+#define CV_DESC_LO(v) (B(v,0,12) | B(v,1,9)  | B(v,2,8)  | B(v,3,2)  | B(v,4,14) | B(v,5,0)  | B(v,6,15) | B(v,7,4))
+#define CV_DESC_HI(v) (B(v,0,1)  | B(v,1,5)  | B(v,2,13) | B(v,3,3)  | B(v,4,7)  | B(v,5,6)  | B(v,6,11) | B(v,7,10))
+/* P: data bits 7:0 / 15:8 of the file -> chip */
+#define P_SCR_LO(v)   (B(v,0,15) | B(v,1,7)  | B(v,2,14) | B(v,3,6)  | B(v,4,13) | B(v,5,5)  | B(v,6,12) | B(v,7,4))
+#define P_SCR_HI(v)   (B(v,0,0)  | B(v,1,8)  | B(v,2,1)  | B(v,3,9)  | B(v,4,2)  | B(v,5,10) | B(v,6,3)  | B(v,7,11))
+/* P: data bits 7:0 / 15:8 of the chip -> file */
+#define P_DESC_LO(v)  (B(v,0,8)  | B(v,1,10) | B(v,2,12) | B(v,3,14) | B(v,4,7)  | B(v,5,5)  | B(v,6,3)  | B(v,7,1))
+#define P_DESC_HI(v)  (B(v,0,9)  | B(v,1,11) | B(v,2,13) | B(v,3,15) | B(v,4,6)  | B(v,5,4)  | B(v,6,2)  | B(v,7,0))
+
+#define T4(f, n)   f(n), f((n) + 1), f((n) + 2), f((n) + 3)
+#define T16(f, n)  T4(f, n), T4(f, (n) + 4), T4(f, (n) + 8), T4(f, (n) + 12)
+#define T64(f, n)  T16(f, n), T16(f, (n) + 16), T16(f, (n) + 32), T16(f, (n) + 48)
+#define T256(f)    T64(f, 0), T64(f, 64), T64(f, 128), T64(f, 192)
+
+uint16_t cv_scr_lo[256]  = { T256(CV_SCR_LO) };
+uint16_t cv_scr_hi[256]  = { T256(CV_SCR_HI) };
+uint16_t cv_desc_lo[256] = { T256(CV_DESC_LO) };
+uint16_t cv_desc_hi[256] = { T256(CV_DESC_HI) };
+uint16_t p_scr_lo[256]   = { T256(P_SCR_LO) };
+uint16_t p_scr_hi[256]   = { T256(P_SCR_HI) };
+uint16_t p_desc_lo[256]  = { T256(P_DESC_LO) };
+uint16_t p_desc_hi[256]  = { T256(P_DESC_HI) };
+
+const uint16_t *scramble_lo;
+const uint16_t *scramble_hi;
+
+/**
+ * @brief Select the tables used by SCRAMBLE_Word()
+ *
+ * @param lo low byte table, NULL = leave data unchanged
+ * @param hi high byte table
+ */
+void SCRAMBLE_Select(const uint16_t *lo, const uint16_t *hi) {
+  scramble_lo = lo;
+  scramble_hi = hi;
+}
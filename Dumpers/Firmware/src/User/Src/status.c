@@ -0,0 +1,193 @@
+#include "main.h"
+#include "status.h"
+
+/*
+ * Status records
+ * ==============
+ *
+ * The erase/program/verify/dump loops report what they are doing many times
+ * a second. Formatting that text right away costs a full LCD_xyprintf() per
+ * sector, region or mismatch, most of which is overwritten before the
+ * screen is refreshed even once.
+ *
+ * Instead the loops append a small binary record (event, address, two
+ * status words) to a single-producer/single-consumer ring. The main loop is
+ * the only producer; the consumer is the LCD refresh in the SPI4 interrupt,
+ * which formats only the newest record for each screen line. Direct LCD
+ * output from the main loop drains the ring first with that interrupt
+ * masked, so text still appears in the order it was written. The producer
+ * never waits: when the ring is full, the oldest records are overwritten
+ * and the consumer skips them, so the last state of each line (a final
+ * error or "done") is never lost.
+ *
+ * With STATUS_USB_MIRROR defined, every record is also sent to the USB CDC
+ * port as one text line: "<tag> <addr> <w0> <w1>", all hex.
+ */
+
+typedef enum {
+  STATUS_ARGS_ADDR,     /* printf(format, addr, w0, w1) */
+  STATUS_ARGS_WORDS,    /* printf(format, w0, w1) */
+  STATUS_ARGS_QUAD      /* printf(format, w0, w1, addr >> 16, addr & 0xffff) */
+} status_args_t;
+
+typedef struct {
+  const char *tag;
+  uint8_t line;
+  uint8_t color;
+  uint8_t args;
+  char *format;
+} status_info_t;
+
+static const status_info_t status_info[STATUS_EVENTS] = {
+  [STATUS_CLEAR]         = { "CLR",  2, 0, STATUS_ARGS_WORDS, "" },
+  [STATUS_PROGRAMMING]   = { "PROG", 0, 0, STATUS_ARGS_WORDS, "Programming %3d%%" },
+  [STATUS_VERIFYING]     = { "VRFY", 0, 0, STATUS_ARGS_WORDS, "Verify %3d%%" },
+  [STATUS_DUMPING]       = { "DUMP", 0, 0, STATUS_ARGS_WORDS, "Dumping %3d%%" },
+  [STATUS_BLANK]         = { "BC",   1, 0, STATUS_ARGS_ADDR,  "BC %08lx.%d" },
+  [STATUS_BLANK_SR]      = { "BCSR", 2, 1, STATUS_ARGS_WORDS, "BC sr=%04x %04x" },
+  [STATUS_BLANK_DIFF]    = { "BCNE", 2, 3, STATUS_ARGS_ADDR,  "BC %08lx=%04x" },
+  [STATUS_ERASE]         = { "ER",   1, 0, STATUS_ARGS_ADDR,  "ER %08lx.%d [%d]" },
+  [STATUS_ERASE_P]       = { "ER",   1, 0, STATUS_ARGS_ADDR,  "ER %08lx [%d]" },
+  [STATUS_ERASE_SR]      = { "ERSR", 2, 1, STATUS_ARGS_WORDS, "ER sr=%04x %04x" },
+  [STATUS_ERASE_SR_P]    = { "ERSR", 2, 1, STATUS_ARGS_WORDS, "ER sr=%04x" },
+  [STATUS_ERASE_RETRY]   = { "ERRT", 2, 1, STATUS_ARGS_ADDR,  "ER %08lx.%d [%d]" },
+  [STATUS_ERASE_CHIPS]   = { "ER4",  1, 0, STATUS_ARGS_QUAD,  "ER %03x %03x %03x %03x" },
+  [STATUS_ERASE_TIMEOUT] = { "ERTO", 2, 0, STATUS_ARGS_WORDS, "ER Timeout" },
+  [STATUS_ERASE_LOCKED]  = { "ERLK", 2, 1, STATUS_ARGS_ADDR,  "ER %08lx.%d locked" },
+  [STATUS_VERIFY]        = { "VR",   1, 0, STATUS_ARGS_ADDR,  "VR %08lx.%d" },
+  [STATUS_VERIFY_P]      = { "VR",   1, 0, STATUS_ARGS_ADDR,  "VR %08lx" },
+  [STATUS_VERIFY_DIFF]   = { "VRNE", 2, 3, STATUS_ARGS_WORDS, "VR %04x != %04x" },
+  [STATUS_PROGRAM]       = { "PG",   1, 0, STATUS_ARGS_ADDR,  "PG %08lx.%d" },
+  [STATUS_PROGRAM_P]     = { "PG",   1, 0, STATUS_ARGS_ADDR,  "PG %08lx" },
+  [STATUS_PROGRAM_SR]    = { "PGSR", 2, 1, STATUS_ARGS_WORDS, "PG sr=%04x %04x" },
+  [STATUS_PROGRAM_SR_P]  = { "PGSR", 2, 1, STATUS_ARGS_WORDS, "PG sr=%04x" },
+  [STATUS_PROGRAM_RETRY] = { "PGRT", 4, 1, STATUS_ARGS_WORDS, "Retrying half %d" },
+  [STATUS_PROGRAM_OK]    = { "PGOK", 4, 2, STATUS_ARGS_WORDS, "Happy Happy Happy :)" },
+  [STATUS_DUMP]          = { "DP",   1, 0, STATUS_ARGS_ADDR,  "DP %08lx" },
+  [STATUS_DUMP_DMA]      = { "DPDE", 1, 0, STATUS_ARGS_ADDR,  "DP %08lx DMA err" },
+};
+
+static status_rec_t status_ring[STATUS_RING_SIZE];
+/* free running; head is only written by the producer, tail by the consumer */
+static volatile uint32_t status_head, status_tail;
+/* records overwritten before they were drained, consumer only */
+static uint32_t status_dropped;
+
+#ifdef STATUS_USB_MIRROR
+#define STATUS_USB_BUF    512
+
+/* one buffer is being sent while the other one fills */
+static uint8_t status_usb_buf[2][STATUS_USB_BUF];
+static uint32_t status_usb_fill, status_usb_len;
+static uint32_t status_usb_dropped;
+
+static char *STATUS_Hex(char *p, uint32_t value, int digits) {
+  while(digits--) {
+    *p++ = "0123456789abcdef"[(value >> (digits * 4)) & 0xf];
+  }
+  return p;
+}
+
+static void STATUS_UsbLine(const char *tag, uint32_t addr, uint16_t w0, uint16_t w1) {
+  char line[32], *p = line;
+
+  while(*tag) *p++ = *tag++;
+  *p++ = ' ';
+  p = STATUS_Hex(p, addr, 8);
+  *p++ = ' ';
+  p = STATUS_Hex(p, w0, 4);
+  *p++ = ' ';
+  p = STATUS_Hex(p, w1, 4);
+  *p++ = '\r';
+  *p++ = '\n';
+  /* the host is not keeping up, the line is lost */
+  if(status_usb_len + (p - line) > STATUS_USB_BUF) return;
+  memcpy(status_usb_buf[status_usb_fill] + status_usb_len, line, p - line);
+  status_usb_len += p - line;
+}
+
+static void STATUS_UsbSend(void) {
+  if(!status_usb_len || hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED) return;
+  if(CDC_Transmit_FS(status_usb_buf[status_usb_fill], status_usb_len) == USBD_OK) {
+    status_usb_fill ^= 1;
+    status_usb_len = 0;
+  }
+}
+#endif
+
+/* main loop only */
+void STATUS_Post(status_event_t event, uint32_t addr, uint16_t w0, uint16_t w1) {
+  uint32_t head = status_head;
+  status_rec_t *rec;
+
+  /* may overwrite the oldest record, STATUS_Drain() skips it */
+  rec = &status_ring[head & (STATUS_RING_SIZE - 1)];
+  rec->event = event;
+  rec->addr = addr;
+  rec->w[0] = w0;
+  rec->w[1] = w1;
+  /* the record must be complete before the consumer can see it */
+  __DMB();
+  status_head = head + 1;
+}
+
+int STATUS_Pending(void) {
+  return status_head != status_tail;
+}
+
+/**
+ * @brief Take all records off the ring. Only one context may drain at a time:
+ *        the LCD refresh, or the main loop with the refresh masked.
+ *
+ * @param show format the newest record of each line onto the screen;
+ *             0 discards them (the screen was cleared)
+ */
+void STATUS_Drain(int show) {
+  uint32_t head = status_head;
+  uint32_t tail = status_tail;
+  uint32_t newest[LCD_LINES];
+  uint8_t seen = 0;
+
+  __DMB();
+  /* the records before head - (STATUS_RING_SIZE - 1) have been overwritten;
+     the slot of head - STATUS_RING_SIZE is also the one an interrupted
+     STATUS_Post() may be writing */
+  if(head - tail > STATUS_RING_SIZE - 1) {
+    status_dropped += head - tail - (STATUS_RING_SIZE - 1);
+    tail = head - (STATUS_RING_SIZE - 1);
+  }
+  for(uint32_t i = tail; i != head; i++) {
+    const status_rec_t *rec = &status_ring[i & (STATUS_RING_SIZE - 1)];
+    uint8_t line = status_info[rec->event].line;
+
+    newest[line] = i;
+    seen |= 1 << line;
+#ifdef STATUS_USB_MIRROR
+    STATUS_UsbLine(status_info[rec->event].tag, rec->addr, rec->w[0], rec->w[1]);
+#endif
+  }
+  for(int line = 0; show && line < LCD_LINES; line++) {
+    const status_rec_t *rec;
+    const status_info_t *info;
+
+    if(!(seen & (1 << line))) continue;
+    rec = &status_ring[newest[line] & (STATUS_RING_SIZE - 1)];
+    info = &status_info[rec->event];
+    if(info->args == STATUS_ARGS_ADDR) {
+      LCD_Status(line, info->color, info->format, (unsigned long)rec->addr, rec->w[0], rec->w[1]);
+    } else if(info->args == STATUS_ARGS_QUAD) {
+      LCD_Status(line, info->color, info->format, rec->w[0], rec->w[1],
+                 (unsigned int)(rec->addr >> 16), (unsigned int)(rec->addr & 0xffff));
+    } else {
+      LCD_Status(line, info->color, info->format, rec->w[0], rec->w[1]);
+    }
+  }
+  status_tail = head;
+#ifdef STATUS_USB_MIRROR
+  if(status_dropped != status_usb_dropped) {
+    status_usb_dropped = status_dropped;
+    STATUS_UsbLine("DROP", status_usb_dropped, 0, 0);
+  }
+  STATUS_UsbSend();
+#endif
+}
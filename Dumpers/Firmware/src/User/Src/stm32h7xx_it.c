@@ -189,3 +189,19 @@ void TIM1_UP_IRQHandler(void)
 {
   HAL_TIM_IRQHandler(&htim1);
 }
+
+/**
+  * @brief This function handles DMA1 stream0 global interrupt (SPI4 TX).
+  */
+void DMA1_Stream0_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_spi4_tx);
+}
+
+/**
+  * @brief This function handles SPI4 global interrupt (LCD renderer).
+  */
+void SPI4_IRQHandler(void)
+{
+  LCD_IRQHandler();
+}
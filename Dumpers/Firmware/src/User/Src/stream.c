@@ -0,0 +1,485 @@
+#include "main.h"
+#include "stream.h"
+
+/*
+ * Background image loader
+ * =======================
+ *
+ * Reads image data from the SD card straight into the sector buffer using
+ * the SDMMC1 IDMA while the CPU is busy talking to the flash chips.
+ *
+ * File offsets are translated to card blocks using the FatFs cluster link
+ * map (fast seek), so no FatFs calls are needed while a transfer is running.
+ * A job is split into chunks of STREAM_CHUNK bytes (less at fragment
+ * boundaries). The next chunk is started from the transfer complete
+ * interrupt. The data is loaded as it is in the file; it is scrambled in
+ * the bus loops on its way to the chip.
+ *
+ * Writes (dumps) work the same way on a file that has been preallocated
+ * contiguously by STREAM_Create(). A write job is issued as one transfer
+ * per file fragment; fragments after the first one are issued from
+ * STREAM_Sync() because the card has to leave programming state first.
+ *
+ * Only one job can be in flight. The card must not be accessed through
+ * FatFs while a job is running; use STREAM_Sync() or STREAM_Close() first.
+ *
+ * If the cluster map does not fit into STREAM_CLMT_SIZE (heavily fragmented
+ * file) jobs fall back to a synchronous f_read/f_write.
+ *
+ * Images opened with STREAM_OpenImage() can be larger or smaller than one
+ * job. "crom:2" is the second job-sized part of a single large file (exFAT
+ * allows more than 4GB), offsets are relative to the start of that part.
+ * A file smaller than one job that is named like a split set (crom-1) is
+ * followed by the next files of the set (crom-2, ...) until the job is
+ * covered. Their cluster maps are built when the image is opened, and a
+ * transfer never crosses from one file into the next. Each map entry is a
+ * run of contiguous clusters, so a card formatted with large clusters (or
+ * an exFAT file written in one go, which is a single run) needs the fewest
+ * entries and card commands per sector.
+ */
+
+typedef struct {
+  FSIZE_t size;
+  DWORD clmt[STREAM_CLMT_SIZE];
+} stream_part_t;
+
+static stream_t *stream_active;
+/* files of a set after the first one, only one image is open at a time */
+static stream_part_t stream_parts[STREAM_MAX_PARTS - 1];
+static FIL stream_part_file;
+
+/* Wait for the card to be ready for the next data command */
+static FRESULT STREAM_CardReady(int write) {
+  uint32_t endtime = ticks + STREAM_TIMEOUT;
+  prof_counter_t prof = PROF_Switch(write ? PROF_SD_WRITE : PROF_SD_READ);
+  FRESULT res = FR_OK;
+
+  while(BSP_SD_GetCardState() != SD_TRANSFER_OK) {
+    if(ticks > endtime) {
+      res = FR_TIMEOUT;
+      break;
+    }
+  }
+  PROF_Switch(prof);
+  return res;
+}
+
+/* Start DMA transfer of the next chunk of the active job */
+static int STREAM_Issue(stream_t *s) {
+  FATFS *fs = s->file->obj.fs;
+  DWORD csz = (DWORD)fs->csize * FF_MAX_SS;
+  FSIZE_t pos = s->ofs + s->requested;
+  FSIZE_t end = f_size(s->file);
+  DWORD *tbl = s->clmt + 1;
+  DWORD cl, ncl;
+  FSIZE_t avail;
+  uint32_t len;
+  LBA_t lba;
+
+  /* find file of the set containing pos */
+  for(int i = 0; pos >= end && i < s->parts - 1; i++) {
+    pos -= end;
+    end = stream_parts[i].size;
+    tbl = stream_parts[i].clmt + 1;
+  }
+  /* find fragment containing pos */
+  cl = pos / csz;
+  for(;;) {
+    ncl = *tbl++;
+    if(!ncl) return 1;
+    if(cl < ncl) break;
+    cl -= ncl;
+    tbl++;
+  }
+  lba = fs->database + (LBA_t)(*tbl + cl - 2) * fs->csize + (pos % csz) / FF_MAX_SS;
+  avail = (FSIZE_t)(ncl - cl) * csz - (pos % csz);
+  if(avail > end - pos) avail = end - pos;
+
+  len = s->valid - s->requested;
+  if(!s->write && len > STREAM_CHUNK) len = STREAM_CHUNK;
+  if(len > avail) len = avail;
+  len = (len + FF_MAX_SS - 1) & ~(FF_MAX_SS - 1);
+
+  s->chunk = len;
+  s->busy = 1;
+  if(s->write) {
+    if(BSP_SD_WriteBlocks_DMA((uint32_t *)(s->dst + s->requested), lba, len / FF_MAX_SS) != MSD_OK) {
+      s->busy = 0;
+      return 1;
+    }
+  } else {
+    if(BSP_SD_ReadBlocks_DMA((uint32_t *)(s->dst + s->requested), lba, len / FF_MAX_SS) != MSD_OK) {
+      s->busy = 0;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void BSP_SD_ReadCpltCallback(void) {
+  stream_t *s = stream_active;
+
+  if(!s || !s->busy) return;
+  s->requested += s->chunk;
+  if(s->requested > s->valid) {
+    s->requested = s->valid;
+  }
+  s->busy = 0;
+  if(s->requested < s->valid) {
+    if(STREAM_Issue(s)) {
+      s->error = 1;
+    }
+  }
+  s->done = s->requested;
+}
+
+void BSP_SD_WriteCpltCallback(void) {
+  stream_t *s = stream_active;
+
+  if(!s || !s->busy) return;
+  s->requested += s->chunk;
+  if(s->requested > s->valid) {
+    s->requested = s->valid;
+  }
+  s->busy = 0;
+  s->done = s->requested;
+}
+
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd) {
+  if(stream_active) {
+    stream_active->busy = 0;
+    stream_active->error = 1;
+  }
+}
+
+/**
+ * @brief Prepare a file for background loading by building its cluster map
+ *
+ * @param s stream state
+ * @param file opened file
+ * @return FRESULT
+ */
+FRESULT STREAM_Open(stream_t *s, FIL *file) {
+  FRESULT res;
+
+  memset(s, 0, sizeof(stream_t));
+  s->file = file;
+  s->size = f_size(file);
+  s->parts = 1;
+  s->clmt[0] = STREAM_CLMT_SIZE;
+  file->cltbl = s->clmt;
+  res = f_lseek(file, CREATE_LINKMAP);
+  if(res == FR_OK) {
+    s->fastpath = 1;
+  } else {
+    file->cltbl = NULL;
+    if(res != FR_NOT_ENOUGH_CORE) {
+      return res;
+    }
+  }
+  return FR_OK;
+}
+
+/**
+ * @brief Split an image name into file name and part number
+ *
+ * @param image image name, "crom" or "crom:2"
+ * @param name file name (STREAM_NAME_LEN bytes)
+ * @return uint32_t part number, 0 for the whole file
+ */
+uint32_t STREAM_ImageName(const char *image, char *name) {
+  const char *sep = strrchr(image, STREAM_PART_SEP);
+  size_t len = sep ? (size_t)(sep - image) : strlen(image);
+
+  if(len >= STREAM_NAME_LEN) len = STREAM_NAME_LEN - 1;
+  memcpy(name, image, len);
+  name[len] = 0;
+  return sep ? strtoul(sep + 1, NULL, 10) : 0;
+}
+
+/* Add the files following name in its set until the job is covered */
+static FRESULT STREAM_OpenSet(stream_t *s, char *name, FSIZE_t job) {
+  char *num = strrchr(name, '-');
+  char *end;
+  unsigned long n;
+  FRESULT res;
+
+  if(!num) return FR_OK;
+  n = strtoul(num + 1, &end, 10);
+  if(end == num + 1 || *end) return FR_OK;
+
+  while(s->size < job && s->parts < STREAM_MAX_PARTS) {
+    stream_part_t *part = &stream_parts[s->parts - 1];
+
+    sprintf(num + 1, "%lu", ++n);
+    res = f_open(&stream_part_file, name, FA_READ);
+    if(res == FR_NO_FILE) break;
+    if(res != FR_OK) return res;
+    /* the files after the first one are only read by DMA, in whole blocks */
+    if(!s->fastpath || s->size % FF_MAX_SS) {
+      f_close(&stream_part_file);
+      return s->fastpath ? FR_INVALID_PARAMETER : FR_NOT_ENOUGH_CORE;
+    }
+    part->clmt[0] = STREAM_CLMT_SIZE;
+    stream_part_file.cltbl = part->clmt;
+    res = f_lseek(&stream_part_file, CREATE_LINKMAP);
+    part->size = f_size(&stream_part_file);
+    stream_part_file.cltbl = NULL;
+    f_close(&stream_part_file);
+    if(res != FR_OK) return res;
+    s->size += part->size;
+    s->parts++;
+  }
+  return FR_OK;
+}
+
+/**
+ * @brief Open an image for background loading: a whole file, one part of
+ *        a file larger than a job ("crom:2"), or a file smaller than a job
+ *        followed by the next files of its set (crom-1, crom-2, ...)
+ *
+ * @param s stream state
+ * @param file file object for the (first) file
+ * @param image image name, see STREAM_ImageName()
+ * @param job bytes per job, the size of one part
+ * @return FRESULT; the file is closed again on error
+ */
+FRESULT STREAM_OpenImage(stream_t *s, FIL *file, const char *image, FSIZE_t job) {
+  static char name[STREAM_NAME_LEN];
+  uint32_t part = STREAM_ImageName(image, name);
+  FRESULT res;
+
+  res = f_open(file, name, FA_READ);
+  if(res != FR_OK) return res;
+  res = STREAM_Open(s, file);
+  if(res == FR_OK && part) {
+    s->base = (FSIZE_t)(part - 1) * job;
+    if(s->base >= s->size) res = FR_INVALID_NAME;
+  } else if(res == FR_OK && s->size < job) {
+    res = STREAM_OpenSet(s, name, job);
+  }
+  if(res != FR_OK) {
+    STREAM_Close(s);
+    f_close(file);
+  }
+  return res;
+}
+
+/**
+ * @brief Preallocate a newly created file contiguously and prepare it for
+ *        background writing. If the card has no contiguous free space of
+ *        the requested size, writes fall back to f_write.
+ *
+ * @param s stream state
+ * @param file file opened for writing, empty
+ * @param size final file size
+ * @return FRESULT
+ */
+FRESULT STREAM_Create(stream_t *s, FIL *file, FSIZE_t size) {
+  FRESULT res;
+
+  res = f_expand(file, size, 1);
+  if(res != FR_OK && res != FR_DENIED) {
+    return res;
+  }
+  if(res == FR_DENIED) {
+    memset(s, 0, sizeof(stream_t));
+    s->file = file;
+    return FR_OK;
+  }
+  return STREAM_Open(s, file);
+}
+
+/**
+ * @brief Start loading a block of the file in the background. Data beyond
+ *        the end of file is filled with 0xff. Check s->valid for the amount
+ *        of actual file data (0 = end of file).
+ *
+ * @param s stream state
+ * @param dst destination buffer (AXI SRAM, word aligned)
+ * @param ofs offset in the image (or the part of it)
+ * @param length number of bytes (multiple of 512)
+ * @return FRESULT
+ */
+FRESULT STREAM_Start(stream_t *s, void *dst, FSIZE_t ofs, uint32_t length) {
+  FSIZE_t size = s->size;
+  prof_counter_t prof;
+  FRESULT res;
+  UINT br;
+
+  ofs += s->base;
+  s->dst = dst;
+  s->ofs = ofs;
+  s->length = length;
+  s->valid = (ofs >= size) ? 0 : (size - ofs > length) ? length : size - ofs;
+  s->requested = 0;
+  s->done = 0;
+  s->error = 0;
+  s->write = 0;
+  if(!s->valid) return FR_OK;
+
+  if(s->fastpath && !(ofs % FF_MAX_SS)) {
+    res = STREAM_CardReady(0);
+    if(res != FR_OK) {
+      s->error = 1;
+      return res;
+    }
+    stream_active = s;
+    if(STREAM_Issue(s)) {
+      s->error = 1;
+      return FR_DISK_ERR;
+    }
+    return FR_OK;
+  }
+
+  prof = PROF_Switch(PROF_SD_READ);
+  res = f_lseek(s->file, ofs);
+  if(res == FR_OK) {
+    res = f_read(s->file, dst, s->valid, &br);
+    s->valid = br;
+  }
+  PROF_Switch(prof);
+  if(res != FR_OK) {
+    s->error = 1;
+    return res;
+  }
+  s->requested = s->done = s->valid;
+  return FR_OK;
+}
+
+/**
+ * @brief Start writing a block to the file in the background. The buffer
+ *        must not be modified until STREAM_Sync() has returned for it.
+ *
+ * @param s stream state
+ * @param src source buffer (AXI SRAM, word aligned)
+ * @param ofs file offset
+ * @param length number of bytes (multiple of 512)
+ * @return FRESULT
+ */
+FRESULT STREAM_Write(stream_t *s, const void *src, FSIZE_t ofs, uint32_t length) {
+  prof_counter_t prof;
+  FRESULT res;
+  UINT bw;
+
+  s->dst = (uint8_t *)src;
+  s->ofs = ofs;
+  s->length = length;
+  s->valid = length;
+  s->requested = 0;
+  s->done = 0;
+  s->error = 0;
+  s->write = 1;
+
+  if(s->fastpath && !(ofs % FF_MAX_SS)) {
+    res = STREAM_CardReady(1);
+    if(res != FR_OK) {
+      s->error = 1;
+      return res;
+    }
+    stream_active = s;
+    if(STREAM_Issue(s)) {
+      s->error = 1;
+      return FR_DISK_ERR;
+    }
+    return FR_OK;
+  }
+
+  prof = PROF_Switch(PROF_SD_WRITE);
+  res = f_lseek(s->file, ofs);
+  if(res == FR_OK) {
+    res = f_write(s->file, src, length, &bw);
+    if(res == FR_OK && bw != length) {
+      res = FR_DENIED; // disk full
+    }
+  }
+  PROF_Switch(prof);
+  if(res != FR_OK) {
+    s->error = 1;
+    return res;
+  }
+  s->requested = s->done = length;
+  return FR_OK;
+}
+
+/**
+ * @brief Wait until at least the first bytes of the current job are loaded.
+ *
+ * @param s stream state
+ * @param bytes number of bytes from the job start that need to be available
+ * @return FRESULT FR_OK, FR_DISK_ERR or FR_TIMEOUT
+ */
+FRESULT STREAM_Sync(stream_t *s, uint32_t bytes) {
+  uint32_t endtime = ticks + STREAM_TIMEOUT;
+  uint32_t last = s->done;
+  prof_counter_t prof = PROF_Switch(s->write ? PROF_SD_WRITE : PROF_SD_READ);
+
+  if(bytes > s->length) bytes = s->length;
+  while(s->done < bytes && s->done < s->valid) {
+    if(s->error) break;
+    /* next fragment of a write job */
+    if(s->write && !s->busy && s->requested < s->valid) {
+      if(STREAM_CardReady(1) != FR_OK || STREAM_Issue(s)) {
+        s->error = 1;
+        break;
+      }
+    }
+    if(s->done != last) {
+      last = s->done;
+      endtime = ticks + STREAM_TIMEOUT;
+    }
+    if(ticks > endtime) {
+      PROF_Switch(prof);
+      return FR_TIMEOUT;
+    }
+    __WFI();
+  }
+  PROF_Switch(prof);
+  if(s->error) return FR_DISK_ERR;
+  /* pad past end of file */
+  if(s->done == s->valid && s->valid < s->length) {
+    memset(s->dst + s->valid, 0xff, s->length - s->valid);
+    s->done = s->length;
+  }
+  return FR_OK;
+}
+
+/**
+ * @brief Check whether the first bytes of the current job are all 0xff.
+ *        Waits for the data only as far as needed to tell; a sector with
+ *        data is usually recognized in its first chunk.
+ *
+ * @param s stream state
+ * @param bytes number of bytes from the job start to check
+ * @return int 1 if all 0xff (padding past end of file included), 0 if not
+ *         or on error; the error is reported by the next STREAM_Sync()
+ */
+int STREAM_IsBlank(stream_t *s, uint32_t bytes) {
+  const uint32_t *p = (const uint32_t *)s->dst;
+  uint32_t end;
+
+  if(bytes > s->length) bytes = s->length;
+  for(uint32_t ofs = 0; ofs < bytes; ofs = end) {
+    end = ofs + STREAM_CHUNK < bytes ? ofs + STREAM_CHUNK : bytes;
+    if(STREAM_Sync(s, end) != FR_OK) return 0;
+    for(uint32_t i = ofs / 4; i < end / 4; i++) {
+      if(p[i] != 0xffffffff) return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Stop background loading (aborting a transfer in flight) and release
+ *        the file's cluster map. Must be called before closing the file.
+ *
+ * @param s stream state
+ */
+void STREAM_Close(stream_t *s) {
+  stream_active = NULL;
+  if(s->busy) {
+    HAL_SD_Abort(&hsd1);
+    s->busy = 0;
+  }
+  s->file->cltbl = NULL;
+}
@@ -530,14 +530,14 @@ void Delay_Init(void)
 void Delay_us(uint32_t us) // microseconds
 {
   uint32_t delayTicks = us * (SystemCoreClock/1000000);
-  DWT->CYCCNT = 0;
-  while (DWT->CYCCNT < delayTicks);
+  uint32_t start = DWT->CYCCNT;
+  while ((DWT->CYCCNT - start) < delayTicks);
 }
 
 inline void Delay_cycles(uint32_t cyc)
 {
-  DWT->CYCCNT = 0;
-  while (DWT->CYCCNT < cyc);
+  uint32_t start = DWT->CYCCNT;
+  while ((DWT->CYCCNT - start) < cyc);
 }
 
 /**
@@ -1,3 +1,4 @@
+#include <strings.h>
 #include "main.h"
 #include "tools.h"
 
@@ -129,42 +130,24 @@ void waitButton() {
   flag_button &= ~FLAG_BTN_BRD;
 }
 
-FRESULT saveProgress(uint32_t addr, const char *filename, chip_t chiptype) {
-  FIL fp;
-  FRESULT res;
-  if((res = f_open(&fp, PROG_SAVE_FILE, FA_CREATE_ALWAYS | FA_WRITE)) != FR_OK) {
-    return res;
+/**
+ * @brief Files the firmware writes next to images (manifests, profiler logs,
+ *        dump checksums, saved progress, programmed builds) and the
+ *        compiler's layout report and delta lists, which are never images
+ *        themselves
+ */
+int is_sidecar_file(const char *name) {
+  static const char *sidecar_ext[] = { MAN_EXT, ".csv", HASH_EXT, ".log", DLT_EXT, DLT_LAST_EXT };
+  size_t len = strlen(name);
+
+  if(!strcasecmp(name, PROG_SAVE_FILE)) return 1;
+  for(int i = 0; i < sizeof(sidecar_ext) / sizeof(sidecar_ext[0]); i++) {
+    size_t ext = strlen(sidecar_ext[i]);
+    if(len > ext && !strcasecmp(name + len - ext, sidecar_ext[i])) return 1;
   }
-  f_write(&fp, &addr, sizeof(addr), NULL);
-  f_write(&fp, &chiptype, sizeof(chiptype), NULL);
-  f_puts(filename, &fp);
-  f_close(&fp);
   return 0;
 }
 
-FRESULT loadProgress(uint32_t *addr, char *filename, chip_t *chiptype) {
-  FIL fp;
-  FRESULT res;
-  UINT bytesread;
-
-  if((res = f_open(&fp, PROG_SAVE_FILE, FA_READ)) != FR_OK) {
-    return res;
-  }
-
-  f_read(&fp, addr, sizeof(uint32_t), &bytesread);
-  if(bytesread < sizeof(uint32_t)){
-    res = 1;
-  }
-  f_read(&fp, chiptype, sizeof(chip_t), &bytesread);
-  if(bytesread < sizeof(chip_t)){
-    res = 1;
-  }
-  f_gets(filename, 80, &fp);
-  f_close(&fp);
-
-  return res;
-}
-
 int waitYesNo() {
   LCD_printf(0, "Short=NO Long=YES\n");
   while(1) {
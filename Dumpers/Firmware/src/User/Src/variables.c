@@ -4,6 +4,7 @@
 // MX Handles
 UART_HandleTypeDef huart3;
 SPI_HandleTypeDef hspi4;
+DMA_HandleTypeDef hdma_spi4_tx;
 SD_HandleTypeDef hsd1;
 USBD_HandleTypeDef hUsbDeviceFS;
 TIM_HandleTypeDef htim1;
@@ -69,7 +70,6 @@ const char *DUMP_FILENAMES[] = {
   DUMP_FILENAME_V
 };
 
-// scrable lookup tables
-uint16_t scramble_lookup[65536] D2SRAM_BUFFER;
+// address scramble lookup table
 uint16_t addr_lookup[512];
 